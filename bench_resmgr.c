@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "resmgr.h"
+
+#define DEFAULT_OPS 1000000
+#define STEP_NANO 50000 // Simulated time between operations
+#define DETECT_EVERY 32 // Operations between deadlock detection runs
+#define EXIT_CHANCE 2 // % chance a running process exits instead of acting
+#define NUM_OPS 7
+#define NUM_LEVELS 3
+
+// bench_resmgr.c measures the resource manager on its own, no IPC or workers. For each table size (processes registered) and contention level it
+// drives a random mix of requests, releases, exits and deadlock handling through resmgr.h and times every call, reporting ns/op per operation.
+// Usage: ./bench_resmgr [ops] [wake-up policy list]
+
+enum { OP_REGISTER, OP_GRANT, OP_BLOCK, OP_RELEASE, OP_DETECT, OP_PREEMPT, OP_KILL };
+char *opNames[NUM_OPS] = { "register", "grant", "block", "release", "detect", "preempt", "kill" };
+
+typedef struct ContentionLevel { // How requests spread over resources
+	char *name;
+	int resources; // Requests go to R0 up to this many resources
+	int minQuantity;
+	int maxQuantity;
+} ContentionLevel;
+
+ContentionLevel levels[NUM_LEVELS] = {
+	{ "low", NUM_RESOURCES, 1, 1 }, // Single units spread over every resource, nearly everything is granted
+	{ "medium", 2, 1, 3 }, // Two resources, a few units at a time
+	{ "high", 1, 2, 5 }, // Everyone fights over R0, most requests block
+};
+
+int tableSizes[] = { 1, 5, 10, MAX_PCB };
+
+typedef struct OpTiming {
+	unsigned long long ns;
+	unsigned long long count;
+} OpTiming;
+
+static unsigned long long randomState = 88172645463325252ULL;
+
+static unsigned int nextRandom() { // xorshift, cheap enough not to show up next to the calls being timed
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 7;
+	randomState ^= randomState << 17;
+	return (unsigned int) (randomState >> 32);
+}
+
+static unsigned long long nowNano() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned long long timerOverhead() { // Cost of the two clock reads around every call, taken off each sample
+	unsigned long long best = ~0ULL;
+	for (int i = 0; i < 1000; i++) {
+		unsigned long long begin = nowNano();
+		unsigned long long end = nowNano();
+		if (end - begin < best) {
+			best = end - begin;
+		}
+	}
+	return best;
+}
+
+static void record(OpTiming *timing, int op, unsigned long long begin, unsigned long long end, unsigned long long overhead) {
+	unsigned long long elapsed = end - begin;
+	timing[op].ns += (elapsed > overhead) ? elapsed - overhead : 0;
+	timing[op].count++;
+}
+
+static void registerProcess(ResourceManager *rm, int pcbIndex, pid_t pid, OpTiming *timing, unsigned long long overhead) {
+	int priority = nextRandom() % NUM_PRIORITIES;
+
+	unsigned long long begin = nowNano();
+	resmgrRegister(rm, pcbIndex, pid, priority);
+	record(timing, OP_REGISTER, begin, nowNano(), overhead);
+}
+
+static void killProcess(ResourceManager *rm, int pcbIndex, pid_t *nextPid, unsigned long long now, OpTiming *timing, unsigned long long overhead) { // Kill and replace
+	ResmgrGrant grants[MAX_PCB];
+	unsigned long long begin = nowNano();
+	resmgrUnregister(rm, pcbIndex, now, grants);
+	record(timing, OP_KILL, begin, nowNano(), overhead);
+	registerProcess(rm, pcbIndex, (*nextPid)++, timing, overhead);
+}
+
+static void runConfig(char *policies, int procs, ContentionLevel *level, int ops, unsigned long long overhead) {
+	static PCB processTable[MAX_PCB];
+	static ResourceDesc resourceTable[NUM_RESOURCES];
+	static WaitStats waitStats[NUM_WAKE_POLICIES];
+	ResourceManager rm;
+	OpTiming timing[NUM_OPS];
+	memset(timing, 0, sizeof(timing));
+	memset(waitStats, 0, sizeof(waitStats));
+
+	resmgrInit(&rm, processTable, resourceTable, waitStats);
+	resmgrReset(&rm);
+	resmgrSetPolicies(&rm, policies);
+
+	pid_t nextPid = 1000;
+	for (int i = 0; i < procs; i++) {
+		registerProcess(&rm, i, nextPid++, timing, overhead);
+	}
+
+	unsigned long long now = 0;
+	unsigned long long blockedSamples = 0;
+	ResmgrGrant grants[MAX_PCB];
+	for (int op = 0; op < ops; op++) {
+		now += STEP_NANO;
+		int pcbIndex = nextRandom() % procs;
+		PCB *pcb = &processTable[pcbIndex];
+
+		if (op % DETECT_EVERY == DETECT_EVERY - 1) { // Resolve until clean, oss only takes one victim a second but here stuck processes would skew every other column
+			int deadlocked[MAX_PCB];
+			int numDeadlocked;
+			do {
+				unsigned long long begin = nowNano();
+				numDeadlocked = resmgrDetect(&rm, deadlocked, now);
+				record(timing, OP_DETECT, begin, nowNano(), overhead);
+
+				if (numDeadlocked > 0) { // Alternate strategies so both get timed
+					begin = nowNano();
+					int victim = (timing[OP_DETECT].count % 2) ? resmgrPreemptVictim(&rm, deadlocked, numDeadlocked) : -1;
+					if (victim != -1) {
+						resmgrPreempt(&rm, victim, now, grants);
+						record(timing, OP_PREEMPT, begin, nowNano(), overhead);
+					} else {
+						killProcess(&rm, resmgrKillVictim(&rm, deadlocked, numDeadlocked), &nextPid, now, timing, overhead);
+					}
+				}
+			} while (numDeadlocked > 0);
+		}
+
+		if (pcb->blocked) { // Waits for a release or for detection to break its deadlock
+			blockedSamples++;
+			continue;
+		}
+
+		if ((int) (nextRandom() % 100) < EXIT_CHANCE) { // Process finished, a new one takes its slot
+			killProcess(&rm, pcbIndex, &nextPid, now, timing, overhead);
+			continue;
+		}
+
+		if (nextRandom() % 2) { // Give back something it holds, if anything
+			int held = -1;
+			int start = nextRandom() % NUM_RESOURCES;
+			for (int j = 0; j < NUM_RESOURCES && held == -1; j++) {
+				if (pcb->resourceAllocated[(start + j) % NUM_RESOURCES] > 0) {
+					held = (start + j) % NUM_RESOURCES;
+				}
+			}
+			if (held != -1) {
+				unsigned long long begin = nowNano();
+				resmgrRelease(&rm, pcbIndex, held, now, grants);
+				record(timing, OP_RELEASE, begin, nowNano(), overhead);
+				continue;
+			}
+		}
+
+		int resourceID = nextRandom() % level->resources;
+		int quantity = level->minQuantity + nextRandom() % (level->maxQuantity - level->minQuantity + 1);
+		unsigned long long begin = nowNano();
+		int result = resmgrRequest(&rm, pcbIndex, resourceID, quantity, now);
+		record(timing, result == RESMGR_BLOCKED ? OP_BLOCK : OP_GRANT, begin, nowNano(), overhead);
+	}
+
+	printf("%5d %-10s %6.1f%%", procs, level->name, (double) blockedSamples * 100 / ops);
+	for (int i = 0; i < NUM_OPS; i++) {
+		if (timing[i].count == 0) {
+			printf(" %9s", "-");
+		} else {
+			printf(" %9.1f", (double) timing[i].ns / timing[i].count);
+		}
+	}
+	printf("\n");
+}
+
+int main(int argc, char **argv) {
+	int ops = (argc > 1) ? atoi(argv[1]) : DEFAULT_OPS;
+	char *policies = (argc > 2) ? argv[2] : "ring";
+	if (ops < 1) {
+		printf("Usage: ./bench_resmgr [ops] [wake-up policy list]\n");
+		exit(1);
+	}
+
+	static PCB processTable[MAX_PCB];
+	static ResourceDesc resourceTable[NUM_RESOURCES];
+	static WaitStats waitStats[NUM_WAKE_POLICIES];
+	ResourceManager check;
+	resmgrInit(&check, processTable, resourceTable, waitStats);
+	if (resmgrSetPolicies(&check, policies) == -1) {
+		printf("Error: invalid wake-up policy list %s (use ring, fifo, smallest or aging). \n", policies);
+		exit(1);
+	}
+
+	unsigned long long overhead = timerOverhead();
+	printf("bench_resmgr: %d ops per run, wake-up policy %s, %llu ns timer overhead removed, ns/op below\n", ops, policies, overhead);
+	printf("%5s %-10s %7s", "procs", "contention", "blocked");
+	for (int i = 0; i < NUM_OPS; i++) {
+		printf(" %9s", opNames[i]);
+	}
+	printf("\n");
+
+	for (int l = 0; l < NUM_LEVELS; l++) {
+		for (int t = 0; t < (int) (sizeof(tableSizes) / sizeof(tableSizes[0])); t++) {
+			runConfig(policies, tableSizes[t], &levels[l], ops, overhead);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#include "oss.h"
+
+#define DEFAULT_READERS 4
+#define MAX_READERS 16
+#define DEFAULT_TICKS 20000000
+
+// bench_shm.c measures the memory traffic of the shared state. A writer plays oss, bumping the clock every tick and then making the table writes of
+// a grant, a release and a block, while reader processes play user.c and spin on the clock. It runs once with the baseline layout (the clock alone
+// in one SysV segment, the unaligned ResourceDesc array in a second one) and once with SharedRegion from oss.h, and reports time and hardware cache
+// misses from perf counters for both sides.
+// Usage: ./bench_shm [readers] [ticks]
+
+typedef struct BaselineResourceDesc { // ResourceDesc as the baseline had it, packed back to back in its own segment
+	int totalInstances;
+	int availableInstances;
+	int resourceAllocated[MAX_PCB];
+	int requestQueue[MAX_PCB];
+	int head;
+	int tail;
+} BaselineResourceDesc;
+
+typedef struct ResourceFields { // Where the fields oss writes live in one layout
+	volatile int *availableInstances;
+	volatile int *resourceAllocated;
+	volatile int *requestQueue;
+	volatile int *tail;
+} ResourceFields;
+
+typedef struct BenchResult { // One per process, on its own line so reporting doesn't add traffic
+	unsigned long long ns;
+	unsigned long long operations;
+	long long cacheMisses; // -1 when perf counters aren't available
+	long long cacheReferences;
+} __attribute__((aligned(CACHE_LINE_SIZE))) BenchResult;
+
+typedef struct BenchControl { // Lives in its own mapping, away from the measured region
+	volatile int ready __attribute__((aligned(CACHE_LINE_SIZE))); // Readers spinning and waiting for the start
+	volatile int start __attribute__((aligned(CACHE_LINE_SIZE)));
+	volatile int done __attribute__((aligned(CACHE_LINE_SIZE)));
+	BenchResult writer;
+	BenchResult readers[MAX_READERS];
+} BenchControl;
+
+static unsigned long long nowNano() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int perfOpen(unsigned long long config, int group) { // Count a hardware event for this process in user space
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = config;
+	attr.disabled = (group == -1);
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+typedef struct PerfCounters {
+	int missFd;
+	int referenceFd;
+} PerfCounters;
+
+static void perfStart(PerfCounters *counters) {
+	counters->missFd = perfOpen(PERF_COUNT_HW_CACHE_MISSES, -1);
+	counters->referenceFd = (counters->missFd == -1) ? -1 : perfOpen(PERF_COUNT_HW_CACHE_REFERENCES, counters->missFd);
+	if (counters->missFd != -1) {
+		ioctl(counters->missFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(counters->missFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+}
+
+static void perfStop(PerfCounters *counters, BenchResult *result) {
+	result->cacheMisses = -1;
+	result->cacheReferences = -1;
+	if (counters->missFd == -1) {
+		return;
+	}
+
+	ioctl(counters->missFd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+	long long value;
+	if (read(counters->missFd, &value, sizeof(value)) == sizeof(value)) {
+		result->cacheMisses = value;
+	}
+	if (counters->referenceFd != -1 && read(counters->referenceFd, &value, sizeof(value)) == sizeof(value)) {
+		result->cacheReferences = value;
+	}
+	close(counters->missFd);
+	if (counters->referenceFd != -1) {
+		close(counters->referenceFd);
+	}
+}
+
+static void runReader(BenchControl *control, BenchResult *result, volatile SimulatedClock *clock) {
+	PerfCounters counters;
+	perfStart(&counters);
+	__sync_fetch_and_add(&control->ready, 1);
+	while (!control->start) {
+		// Wait for the writer
+	}
+
+	unsigned long long begin = nowNano();
+	unsigned long long reads = 0;
+	while (!control->done) { // Same access user.c makes in its main loop, volatile keeps every read
+		(void) (clock->seconds + clock->nanoseconds);
+		reads++;
+	}
+	result->ns = nowNano() - begin;
+	perfStop(&counters, result);
+	result->operations = reads;
+}
+
+static void runWriter(BenchControl *control, BenchResult *result, volatile SimulatedClock *clock, ResourceFields *resources, int readers, int ticks) {
+	PerfCounters perf;
+	while (control->ready < readers) {
+		// Wait until every reader is spinning
+	}
+	perfStart(&perf);
+	control->start = 1;
+
+	unsigned long long begin = nowNano();
+	for (int i = 0; i < ticks; i++) { // Same writes oss makes per loop
+		clock->nanoseconds += 1;
+
+		ResourceFields *resource = &resources[i % NUM_RESOURCES];
+		int pcbIndex = i % MAX_PCB;
+		*resource->availableInstances -= 1; // Grant
+		resource->resourceAllocated[pcbIndex] += 1;
+		*resource->availableInstances += 1; // Release
+		resource->resourceAllocated[pcbIndex] -= 1;
+		resource->requestQueue[*resource->tail] = pcbIndex; // Block
+		*resource->tail = (*resource->tail + 1) % MAX_PCB;
+	}
+	result->ns = nowNano() - begin;
+	control->done = 1;
+	perfStop(&perf, result);
+	result->operations = ticks;
+}
+
+static void runLayout(const char *name, volatile SimulatedClock *clock, ResourceFields *resources, int readers, int ticks) {
+	BenchControl *control = mmap(NULL, sizeof(BenchControl), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (control == MAP_FAILED) {
+		printf("Error: bench_shm failed to map control block. \n");
+		exit(1);
+	}
+	memset(control, 0, sizeof(BenchControl));
+
+	for (int i = 0; i < readers; i++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			runReader(control, &control->readers[i], clock);
+			_exit(0);
+		}
+	}
+
+	runWriter(control, &control->writer, clock, resources, readers, ticks);
+	while (wait(NULL) > 0) {
+		// Collect readers
+	}
+
+	unsigned long long totalReads = 0;
+	long long readerMisses = 0;
+	int perfAvailable = (control->writer.cacheMisses != -1);
+	for (int i = 0; i < readers; i++) {
+		totalReads += control->readers[i].operations;
+		if (control->readers[i].cacheMisses == -1) {
+			perfAvailable = 0;
+		} else {
+			readerMisses += control->readers[i].cacheMisses;
+		}
+	}
+
+	printf("%-8s writer %7.2f ns/tick", name, (double) control->writer.ns / ticks);
+	if (perfAvailable) {
+		printf("  %6.3f misses/tick (%lld refs)", (double) control->writer.cacheMisses / ticks, control->writer.cacheReferences);
+	}
+	printf("  readers %8.2f Mreads/s", (double) totalReads * 1000.0 / control->writer.ns);
+	if (perfAvailable && totalReads > 0) {
+		printf("  %6.3f misses/1k reads", (double) readerMisses * 1000.0 / totalReads);
+	}
+	printf("\n");
+
+	munmap(control, sizeof(BenchControl));
+}
+
+int main(int argc, char **argv) {
+	int readers = (argc > 1) ? atoi(argv[1]) : DEFAULT_READERS;
+	int ticks = (argc > 2) ? atoi(argv[2]) : DEFAULT_TICKS;
+	if (readers < 1 || readers > MAX_READERS || ticks < 1) {
+		printf("Usage: ./bench_shm [readers 1-%d] [ticks]\n", MAX_READERS);
+		exit(1);
+	}
+
+	printf("bench_shm: %d readers, %d ticks, a grant, release and block per tick, %d byte cache lines\n", readers, ticks, CACHE_LINE_SIZE);
+
+	// Baseline layout, two SysV segments like oss used to create
+	int clockID = shmget(IPC_PRIVATE, sizeof(SimulatedClock), IPC_CREAT | 0600);
+	int tableID = shmget(IPC_PRIVATE, sizeof(BaselineResourceDesc) * NUM_RESOURCES, IPC_CREAT | 0600);
+	if (clockID == -1 || tableID == -1) {
+		printf("Error: bench_shm shmget failed. \n");
+		exit(1);
+	}
+	SimulatedClock *baselineClock = (SimulatedClock *) shmat(clockID, NULL, 0);
+	BaselineResourceDesc *baselineTable = (BaselineResourceDesc *) shmat(tableID, NULL, 0);
+	shmctl(clockID, IPC_RMID, NULL); // Gone once detached, readers inherit the attachments
+	shmctl(tableID, IPC_RMID, NULL);
+	if (baselineClock == (void *) -1 || baselineTable == (void *) -1) {
+		printf("Error: bench_shm shmat failed. \n");
+		exit(1);
+	}
+
+	// New layout
+	SharedRegion *shared = mmap(NULL, sizeof(SharedRegion), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED) {
+		printf("Error: bench_shm failed to map regions. \n");
+		exit(1);
+	}
+	memset(baselineClock, 0, sizeof(SimulatedClock));
+	memset(baselineTable, 0, sizeof(BaselineResourceDesc) * NUM_RESOURCES);
+	memset(shared, 0, sizeof(SharedRegion));
+
+	ResourceFields baselineFields[NUM_RESOURCES];
+	ResourceFields sharedFields[NUM_RESOURCES];
+	for (int i = 0; i < NUM_RESOURCES; i++) {
+		baselineFields[i].availableInstances = &baselineTable[i].availableInstances;
+		baselineFields[i].resourceAllocated = baselineTable[i].resourceAllocated;
+		baselineFields[i].requestQueue = baselineTable[i].requestQueue;
+		baselineFields[i].tail = &baselineTable[i].tail;
+		sharedFields[i].availableInstances = &shared->resourceTable[i].availableInstances;
+		sharedFields[i].resourceAllocated = shared->resourceTable[i].resourceAllocated;
+		sharedFields[i].requestQueue = shared->resourceTable[i].requestQueue;
+		sharedFields[i].tail = &shared->resourceTable[i].tail;
+	}
+
+	runLayout("baseline", baselineClock, baselineFields, readers, ticks);
+	runLayout("region", &shared->clock, sharedFields, readers, ticks);
+
+	int probe = perfOpen(PERF_COUNT_HW_CACHE_MISSES, -1);
+	if (probe == -1) {
+		printf("perf counters unavailable (check /proc/sys/kernel/perf_event_paranoid), timings only.\n");
+	} else {
+		close(probe);
+	}
+
+	shmdt(baselineClock);
+	shmdt(baselineTable);
+	munmap(shared, sizeof(SharedRegion));
+	return 0;
+}
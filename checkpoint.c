@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "checkpoint.h"
+
+// checkpoint.c writes and restores oss snapshots. Saving is a memcpy into mapped memory followed by an async msync,
+// so the main loop never waits on the disk, and restoring is a memcpy back out of the mapping.
+
+_Static_assert(offsetof(CheckpointFile, activeSlot) == 3 * sizeof(unsigned int), "checkpoint header fields must not move");
+
+static int holdsSnapshot(int fd) { // Any version of oss checkpoint with a complete snapshot in it
+	unsigned int header[4]; // magic, version, slotSize, activeSlot
+	if (pread(fd, header, sizeof(header), 0) != (ssize_t) sizeof(header)) {
+		return 0;
+	}
+	return header[0] == CHECKPOINT_MAGIC && (header[3] == 0 || header[3] == 1);
+}
+
+int checkpointOpen(Checkpoint *ckpt, const char *path, int resume, int overwrite, CheckpointConfig *config) {
+	memset(ckpt, 0, sizeof(Checkpoint));
+	ckpt->fd = -1;
+
+	int fd = open(path, resume ? O_RDWR : (O_RDWR | O_CREAT), 0666);
+	if (fd == -1) {
+		return -1;
+	}
+
+	if (!resume && !overwrite && holdsSnapshot(fd)) { // Starting over would throw away a run that can still be resumed
+		close(fd);
+		return CHECKPOINT_EXISTS;
+	}
+
+	if (!resume && (ftruncate(fd, 0) == -1 || ftruncate(fd, sizeof(CheckpointFile)) == -1)) { // Clear and size the new file before mapping it
+		close(fd);
+		return -1;
+	}
+
+	if (resume) { // Make sure the file is big enough before mapping
+		off_t size = lseek(fd, 0, SEEK_END);
+		if (size < (off_t) sizeof(CheckpointFile)) {
+			close(fd);
+			return -1;
+		}
+	}
+
+	CheckpointFile *map = (CheckpointFile *) mmap(NULL, sizeof(CheckpointFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		close(fd);
+		return -1;
+	}
+
+	if (resume) { // Reject files from another build or layout
+		if (map->magic != CHECKPOINT_MAGIC || map->version != CHECKPOINT_VERSION || map->slotSize != sizeof(CheckpointSlot) || map->activeSlot < 0 || map->activeSlot > 1) {
+			munmap(map, sizeof(CheckpointFile));
+			close(fd);
+			return -1;
+		}
+		ckpt->sequence = map->slots[map->activeSlot].sequence;
+		*config = map->config;
+		config->profile[sizeof(config->profile) - 1] = '\0'; // Don't trust the file's strings
+		config->wakePolicies[sizeof(config->wakePolicies) - 1] = '\0';
+	} else {
+		map->magic = CHECKPOINT_MAGIC;
+		map->version = CHECKPOINT_VERSION;
+		map->slotSize = sizeof(CheckpointSlot);
+		map->config = *config;
+		map->activeSlot = -1;
+	}
+
+	ckpt->fd = fd;
+	ckpt->map = map;
+	return 0;
+}
+
+void checkpointAttach(Checkpoint *ckpt, SimulatedClock *clock, PCB *processTable, ResourceDesc *resourceTable, OssStats *stats, AdmissionControl *admission) {
+	ckpt->clock = clock;
+	ckpt->processTable = processTable;
+	ckpt->resourceTable = resourceTable;
+	ckpt->stats = stats;
+	ckpt->admission = admission;
+}
+
+void checkpointSave(Checkpoint *ckpt) {
+	if (!ckpt->map) { // Checkpointing not enabled
+		return;
+	}
+
+	int next = (ckpt->map->activeSlot == 0) ? 1 : 0; // Never write the slot a restore would read
+	CheckpointSlot *slot = &ckpt->map->slots[next];
+
+	slot->sequence = 0; // Mark as incomplete while copying
+	slot->clock = *ckpt->clock;
+	slot->stats = *ckpt->stats;
+	slot->admission = *ckpt->admission;
+	memcpy(slot->processTable, ckpt->processTable, sizeof(PCB) * MAX_PCB);
+	memcpy(slot->resourceTable, ckpt->resourceTable, sizeof(ResourceDesc) * NUM_RESOURCES);
+	slot->sequence = ++ckpt->sequence;
+
+	__sync_synchronize(); // Slot contents must land before the flip
+	ckpt->map->activeSlot = next;
+	msync(ckpt->map, sizeof(CheckpointFile), MS_ASYNC); // Let the kernel write it back in the background
+}
+
+int checkpointLoad(Checkpoint *ckpt) {
+	if (!ckpt->map || ckpt->map->activeSlot == -1) {
+		return -1;
+	}
+
+	CheckpointSlot *slot = &ckpt->map->slots[ckpt->map->activeSlot];
+	if (slot->sequence == 0) {
+		return -1;
+	}
+
+	*ckpt->clock = slot->clock;
+	*ckpt->stats = slot->stats;
+	*ckpt->admission = slot->admission;
+	memcpy(ckpt->processTable, slot->processTable, sizeof(PCB) * MAX_PCB);
+	memcpy(ckpt->resourceTable, slot->resourceTable, sizeof(ResourceDesc) * NUM_RESOURCES);
+	return 0;
+}
+
+void checkpointFinish(Checkpoint *ckpt) {
+	if (!ckpt->map) {
+		return;
+	}
+	ckpt->map->activeSlot = -1; // Nothing left to resume
+}
+
+void checkpointClose(Checkpoint *ckpt) {
+	if (!ckpt->map) {
+		return;
+	}
+
+	msync(ckpt->map, sizeof(CheckpointFile), MS_SYNC);
+	munmap(ckpt->map, sizeof(CheckpointFile));
+	close(ckpt->fd);
+	ckpt->map = NULL;
+	ckpt->fd = -1;
+}
@@ -0,0 +1,65 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "oss.h"
+
+#define CHECKPOINT_MAGIC 0x4f53534b // "OSSK"
+#define CHECKPOINT_VERSION 11 // Bump whenever PCB, ResourceDesc, OssStats, AdmissionControl or the file layout change
+#define CHECKPOINT_INTERVAL 100000000 // Snapshot every 0.1 simulated seconds
+#define CHECKPOINT_EXISTS -2 // checkpointOpen refused to reset a file that holds a snapshot
+
+// checkpoint.h describes the memory mapped snapshot file oss uses to survive being killed. The file holds two slots, a snapshot is always
+// written into the slot that isn't active and the active index is flipped once it's complete, so a crash mid write leaves the last good one intact.
+
+typedef struct CheckpointSlot { // One full copy of oss state
+	unsigned long long sequence; // Snapshot number, 0 means slot was never written
+	SimulatedClock clock;
+	OssStats stats;
+	PCB processTable[MAX_PCB];
+	ResourceDesc resourceTable[NUM_RESOURCES]; // Includes the wait queues
+	AdmissionControl admission; // Limit, interval and window in progress, so -a carries on where it was
+} CheckpointSlot;
+
+typedef struct CheckpointConfig { // Options the run was started with, a resumed run takes these instead of its own
+	char profile[256]; // -p name or file
+	char wakePolicies[128]; // -w list
+	int totalProcesses; // -n
+	int simul; // -s
+	int interval; // -i in ms
+	int seedGiven; // -r given
+	unsigned int seed;
+	int preempt; // -d, 1 for preempt
+	int admission; // -a
+} CheckpointConfig;
+
+typedef struct CheckpointFile { // Layout of the mapped file
+	unsigned int magic; // The first four fields keep their place across versions, so any oss checkpoint can be recognised
+	unsigned int version;
+	unsigned int slotSize; // sizeof(CheckpointSlot) of the build that wrote it
+	volatile int activeSlot; // Slot with the latest complete snapshot, -1 if none
+	CheckpointConfig config;
+	CheckpointSlot slots[2];
+} CheckpointFile;
+
+typedef struct Checkpoint { // Open checkpoint plus the live state it copies
+	int fd;
+	CheckpointFile *map;
+	unsigned long long sequence;
+	SimulatedClock *clock;
+	PCB *processTable;
+	ResourceDesc *resourceTable;
+	OssStats *stats;
+	AdmissionControl *admission;
+} Checkpoint;
+
+// Open or create the checkpoint file. With resume set the file must already hold a valid snapshot and its run config is copied into config.
+// Otherwise the file is reset and config written to it, but a file holding a snapshot is only reset with overwrite set.
+// Returns 0 on success, CHECKPOINT_EXISTS if a snapshot would have been lost, -1 on failure.
+int checkpointOpen(Checkpoint *ckpt, const char *path, int resume, int overwrite, CheckpointConfig *config);
+void checkpointAttach(Checkpoint *ckpt, SimulatedClock *clock, PCB *processTable, ResourceDesc *resourceTable, OssStats *stats, AdmissionControl *admission); // Set the live state to snapshot
+void checkpointSave(Checkpoint *ckpt); // Copy live state into the inactive slot and flip to it
+int checkpointLoad(Checkpoint *ckpt); // Copy the active slot back into the live state, -1 if there is nothing to load
+void checkpointFinish(Checkpoint *ckpt); // Run completed, drop the snapshot so the file can be reused without -O
+void checkpointClose(Checkpoint *ckpt);
+
+#endif
@@ -5,13 +5,25 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/msg.h>
-#include <sys/shm.h> // For shared memory
-#include <sys/ipc.h> // Also for shared memory, allows worker class to access shared memory
+#include <sys/ipc.h> // For the message queue
 #include <time.h>
 #include <string.h> // For memset
+#include <math.h>
+#include <errno.h>
 #include "oss.h"
+#include "workload.h"
+#include "checkpoint.h"
+#include "region.h"
+#include "resmgr.h"
 
 #define NANO_TO_SEC 1000000000
+#define ADOPTED_POLL_INTERVAL 10000000 // Check adopted workers every 0.01 simulated seconds
+#define ADMISSION_WINDOW 1000000000 // Admission controller decides every simulated second, about one worker lifetime
+#define ADMISSION_BLOCKED_HIGH 0.5 // Blocked fraction of active processes that counts as congestion with resources at target utilization or nobody woken
+#define ADMISSION_UTILIZATION_TARGET 0.8 // Below this resources have room for more processes
+#define ADMIT_HOLD 0
+#define ADMIT_INCREASE 1
+#define ADMIT_DECREASE 2
 
 // Author: Dat Nguyen
 // oss.c is the main function that is in charge of simulating a clock like previous projects, manage a PCB table for processes it'll fork, control the parameters, and most importantly, be in charge of allocating resources to child projects, ensuring that each child process gets the resources they request or put on as waiting list. Additionally, it has deadlocking detection and resolution, ensuring that processes that are blocked and cannot be granted resources gets terminated. 
@@ -21,34 +33,52 @@
 void incrementClock(SimulatedClock *clock, int addSec, int addNano); // Clock increment
 void signalHandler(int sig);
 void help();
+int checkPolicies(char *list); // Validate a -w list before any IPC exists, -1 if invalid
+double wallSince(struct timespec *start); // Real seconds since start
+pid_t spawnUser(char *profileName, int seedGiven, unsigned int childSeed); // Fork and exec a user process
+int workerAlive(pid_t pid); // Check if a worker we can't waitpid() on is still running
+void sendGrant(int msgid, int pcbIndex, int resourceID, int quantity); // Tell a worker its request went through, 0 units means it was rejected
+void deliverGrants(int msgid, ResmgrGrant *grants, int numGranted, FILE *file, int *linesWritten, int verbose, SimulatedClock *clock); // Send grants for woken waiters
+void admissionInit(AdmissionControl *admission, int simul, int interval, WorkloadProfile *profile, unsigned long long now);
+void admissionSample(AdmissionControl *admission, ResourceDesc *resourceTable, int elapsed); // Accumulate live signals over the time just simulated
+int admissionUpdate(AdmissionControl *admission, unsigned long long now, int simul, int draining, char *decision, int size); // End a window, returns 1 if launches were retuned
 
 PCB processTable[MAX_PCB]; // Process Table 
+OssStats stats; // Counters and launch state, kept global so it can be checkpointed
+Checkpoint checkpoint; // Snapshot file, only mapped when -c is given
 
 int main(int argc, char **argv) {
 	int totalProcesses = 40;
 	int simul = 18;
 	int interval = 500;
 	int userInput = 0;
-	int launched = 0;
-	int activeProcesses = 0;
-	int nextLaunchTime = 0;
 	int linesWritten = 0;
 	char *logFileName = "oss.log";
 	int grantsCount = 0;
 	int verbose = 0;
 	unsigned int lastPrintSec = 0;
 	unsigned int lastPrintNano = 0;
-	int totalRequests = 0;
-	int grantedInstantly = 0;
-	int grantedAfterWait = 0;
-	int deadlockDetectedRun = 0;
-	int deadlockTerminations = 0;
-	int deadlockProcesses = 0;
-	int terminations = 0;
 	time_t startTime = time(NULL);
+	char *profileName = "default";
+	int seedGiven = 0;
+	unsigned int seed = 0;
+	WorkloadProfile profile;
+	loadProfile(profileName, &profile); // Replaced by -p
+	char *checkpointName = NULL;
+	int resume = 0;
+	int overwrite = 0;
+	unsigned long long lastCheckpoint = 0;
+	unsigned long long lastAdoptedPoll = 0;
+	int hugePages = 0;
+	char *wakePolicyList = "ring";
+	int preempt = 0; // Deadlock resolution, 0 kills the victim, 1 preempts its resources
+	AdmissionControl admission;
+	admission.enabled = 0;
+	struct timespec wallStart;
+	clock_gettime(CLOCK_MONOTONIC, &wallStart);
 
 	// User Input handler
-	while ((userInput = getopt(argc, argv, "n:s:i:f:hv")) != -1) {
+	while ((userInput = getopt(argc, argv, "n:s:i:f:p:r:c:ROHw:d:ahv")) != -1) {
 		switch(userInput) {
 			case 'n': // How many child processes to launch.
 				totalProcesses = atoi(optarg);
@@ -86,6 +116,48 @@ int main(int argc, char **argv) {
 			case 'v':
 				verbose = 1;
 				break;
+			case 'p': // Workload profile name or file for user processes
+				profileName = optarg;
+				if (loadProfile(profileName, &profile) == -1) {
+					printf("Error: unknown or invalid workload profile %s (built in: ", profileName);
+					listProfiles(stdout);
+					printf(") \n");
+					exit(1);
+				}
+				break;
+			case 'r': // Seed for repeatable runs
+				seed = (unsigned int) strtoul(optarg, NULL, 10);
+				seedGiven = 1;
+				srand(seed);
+				break;
+			case 'c': // Checkpoint file
+				checkpointName = optarg;
+				break;
+			case 'R': // Resume from the checkpoint file
+				resume = 1;
+				break;
+			case 'O': // Start over even if the checkpoint file holds a snapshot
+				overwrite = 1;
+				break;
+			case 'H': // Try huge pages for the shared region
+				hugePages = 1;
+				break;
+			case 'w': // Wake-up policy, checked once the resource table exists
+				wakePolicyList = optarg;
+				break;
+			case 'a': // Adaptive admission control
+				admission.enabled = 1;
+				break;
+			case 'd': // Deadlock resolution strategy
+				if (strcmp(optarg, "kill") == 0) {
+					preempt = 0;
+				} else if (strcmp(optarg, "preempt") == 0) {
+					preempt = 1;
+				} else {
+					printf("Error: deadlock strategy must be kill or preempt. \n");
+					exit(1);
+				}
+				break;
 			case '?': // Invalid user argument handling.
 				printf("Error: Invalid argument detected \n");
 				printf("Usage: ./oss.c -h to learn how to use this program \n");
@@ -93,85 +165,203 @@ int main(int argc, char **argv) {
 		}
 	}
 	
+	if (checkPolicies(wakePolicyList) == -1) {
+		printf("Error: invalid wake-up policy list %s (use ring, fifo, smallest or aging). \n", wakePolicyList);
+		exit(1);
+	}
+
+	if (resume && !checkpointName) {
+		printf("Error: -R needs a checkpoint file given with -c. \n");
+		exit(1);
+	}
+
+	// CHECKPOINT, opened first so a resumed run picks up the options it was started with before anything uses them
+	CheckpointConfig config;
+	memset(&config, 0, sizeof(CheckpointConfig));
+	if (checkpointName) {
+		if (strlen(profileName) >= sizeof(config.profile) || strlen(wakePolicyList) >= sizeof(config.wakePolicies)) {
+			printf("Error: profile or wake-up policy list too long to store in checkpoint file. \n");
+			exit(1);
+		}
+		strcpy(config.profile, profileName);
+		strcpy(config.wakePolicies, wakePolicyList);
+		config.totalProcesses = totalProcesses;
+		config.simul = simul;
+		config.interval = interval;
+		config.seedGiven = seedGiven;
+		config.seed = seed;
+		config.preempt = preempt;
+		config.admission = admission.enabled;
+
+		int opened = checkpointOpen(&checkpoint, checkpointName, resume, overwrite, &config);
+		if (opened == CHECKPOINT_EXISTS) {
+			printf("Error: checkpoint file %s holds a snapshot, resume it with -R or start over with -O. \n", checkpointName);
+			exit(1);
+		}
+		if (opened == -1) {
+			printf("Error: OSS failed to open checkpoint file %s. \n", checkpointName);
+			exit(1);
+		}
+	}
+
+	if (resume) { // Same run as before, whatever options were given this time
+		profileName = config.profile;
+		if (loadProfile(profileName, &profile) == -1) {
+			printf("Error: workload profile %s of checkpoint %s can't be loaded. \n", profileName, checkpointName);
+			exit(1);
+		}
+		wakePolicyList = config.wakePolicies;
+		totalProcesses = config.totalProcesses;
+		simul = config.simul;
+		interval = config.interval;
+		seedGiven = config.seedGiven;
+		seed = config.seed;
+		if (seedGiven) {
+			srand(seed);
+		}
+		preempt = config.preempt;
+		admission.enabled = config.admission;
+		if (checkPolicies(wakePolicyList) == -1) {
+			printf("Error: invalid wake-up policy list %s in checkpoint %s. \n", wakePolicyList, checkpointName);
+			exit(1);
+		}
+	}
+
 	// Start Alarm
 	alarm(60);
 	signal(SIGINT, signalHandler);
 	signal(SIGALRM, signalHandler);
 
-	FILE *file = fopen(logFileName, "w");
+	FILE *file = fopen(logFileName, resume ? "a" : "w"); // Keep the old log when resuming
 	if (!file) {
 		printf("Error: failed opening log file. \n");
 		exit(1);
 	}
 
-	// SIMULATED CLOCK
-	int shmid = shmget(SHM_KEY, sizeof(SimulatedClock), IPC_CREAT | 0666); // Creating shared memory using shmget.
-	if (shmid == -1) { // If shmid is -1 as a result of shmget failing and returning -1, error message will print.
-        	printf("Error: OSS shmget failed. \n");
-        	exit(1);
-    	}
-
-	SimulatedClock *clock = (SimulatedClock *)shmat(shmid, NULL, 0); // Attach shared memory, clock is now a pointer to SimulatedClock structure.
-	if (clock == (void *)-1) { // if shmat, the attaching shared memory function, fails, it returns an invalid memory address.
-		printf("Error: OSS shared memory attachment failed. \n");
+	// SHARED REGION, holds the simulated clock and the resource table
+	RegionMapping mapping;
+	if (regionCreate(&mapping, hugePages) == -1) {
+		printf("Error: OSS failed to create shared memory region. \n");
 		exit(1);
 	}
-
-	// RESOURCE TABLE
-	int shmResourceID = shmget(RESOURCE_KEY, sizeof(ResourceDesc) * NUM_RESOURCES, IPC_CREAT | 0666); // Creating shared memory using shmget.
-	if (shmResourceID == -1) { // Error message in case creating shm fails.
-    		printf("OSS Error: Failed to allocate shared memory for resource table");
-    		exit(1);
-	}
-	
-	ResourceDesc *resourceTable = (ResourceDesc *) shmat(shmResourceID, NULL, 0); // Attach shared memory, resourceTable is a pointer to ResourceDesc 
-	if (resourceTable == (void *) -1) { // Error message in case of attatch fail.
-    		printf("Error: OSS Failed to attach shared memory for resource table");
-		exit(1);
+	if (hugePages && mapping.hugePages != 1) {
+		printf("OSS: Huge pages unavailable for %s, using %s. \n", SHM_NAME, mapping.hugePages == 2 ? "transparent huge pages" : "normal pages");
 	}
+
+	SimulatedClock *clock = &mapping.region->clock; // Clock sits alone on the first cache line of the region
+	ResourceDesc *resourceTable = mapping.region->resourceTable; // Resource table follows, one cache line aligned entry per resource
 	
 	// MESSAGE QUEUE
 	int msgid = msgget(MSG_KEY, IPC_CREAT | 0666); // Setting up msg queue.
         if (msgid == -1) {
                 printf("Error: OSS msgget failed. \n");
+                regionRemove();
                 exit(1);
         }
 
-	// Initialize clock.
-	clock->seconds = 0;
-	clock->nanoseconds = 0;
+	// Initialize clock. A resumed run restores it instead, adopted workers are still reading it.
+	if (!resume) {
+		clock->seconds = 0;
+		clock->nanoseconds = 0;
+	}
 
-	// Initialize PCB tables.
-	for (int i = 0; i < MAX_PCB; i++) {
-		processTable[i].occupied = 0;
-    		processTable[i].pid = -1;
-		processTable[i].startSeconds = 0;
-	        processTable[i].startNano = 0;
-		processTable[i].blocked = 0;
-
-    		for (int j = 0; j < NUM_RESOURCES; j++) { // Initialize resource arrays to 0.
-        		processTable[i].resourceAllocated[j] = 0;
-        		processTable[i].maxResources[j] = 0;
+	// Initialize PCB and resource tables, the resource manager works on them in place.
+	ResourceManager resmgr;
+	resmgrInit(&resmgr, processTable, resourceTable, stats.waitStats);
+	resmgrReset(&resmgr);
+
+	resmgrSetPolicies(&resmgr, wakePolicyList); // Checked before the region was created
+	
+	if (checkpointName) {
+		checkpointAttach(&checkpoint, clock, processTable, resourceTable, &stats, &admission);
+	}
+
+	int unsaved = 0; // Tables or workers changed since the last snapshot
+	if (resume) { // Replace the fresh state with the last snapshot
+		SimulatedClock liveClock = *clock; // Where the killed oss left it, at or past the snapshot
+		if (checkpointLoad(&checkpoint) == -1) {
+			printf("Error: OSS checkpoint %s has no snapshot to resume from. \n", checkpointName);
+			regionRemove();
+			msgctl(msgid, IPC_RMID, NULL);
+			exit(1);
+		}
+		if (liveClock.seconds > clock->seconds || (liveClock.seconds == clock->seconds && liveClock.nanoseconds > clock->nanoseconds)) {
+			*clock = liveClock; // Never move time backwards under adopted workers
+		}
+		fprintf(file, "OSS: Resumed from checkpoint %s at time %u:%u\n", checkpointName, clock->seconds, clock->nanoseconds);
+		printf("OSS: Resumed from checkpoint %s at time %u:%u\n", checkpointName, clock->seconds, clock->nanoseconds);
+		linesWritten++;
+
+		for (int i = 0; i < MAX_PCB; i++) { // Re-adopt workers that are still alive, we can no longer waitpid() on them
+			processTable[i].adopted = processTable[i].occupied && workerAlive(processTable[i].pid);
+		}
+
+		unsigned long long now = (unsigned long long) clock->seconds * NANO_TO_SEC + clock->nanoseconds;
+		ResmgrGrant grants[MAX_PCB]; // Each grant unblocks a different waiter, so every respawn together fits
+		int numGranted = 0;
+		for (int i = 0; i < MAX_PCB; i++) { // Respawn the rest
+			if (!processTable[i].occupied || processTable[i].adopted) {
+				continue;
+			}
+
+			// Worker is gone and its replacement starts holding nothing, so hand its resources back, drop it from every wait queue
+			// and wake whoever the freed units now fit.
+			PCB old = processTable[i];
+			numGranted += resmgrUnregister(&resmgr, i, now, grants + numGranted);
+
+			pid_t childPid = spawnUser(profileName, seedGiven, seed + stats.launched + i);
+			fprintf(file, "OSS: Respawned P%d as P%d\n", old.pid, childPid);
+			printf("OSS: Respawned P%d as P%d\n", old.pid, childPid);
+			linesWritten++;
+
+			resmgrRegister(&resmgr, i, childPid, old.priority); // Same slot and priority
+			processTable[i].preemptCount = old.preemptCount;
+			processTable[i].startSeconds = clock->seconds;
+			processTable[i].startNano = clock->nanoseconds;
+		}
+
+		int delivered = 0; // Only adopted workers are waiting on an answer, grants to dead ones were taken back when they were respawned
+		for (int i = 0; i < numGranted; i++) {
+			if (processTable[grants[i].pcbIndex].adopted) {
+				grants[delivered++] = grants[i];
+			}
 		}
+		deliverGrants(msgid, grants, delivered, file, &linesWritten, verbose, clock);
+		lastCheckpoint = now;
+		unsaved = 1;
 	}
-	
-	// Initialize Resource Table
-	for (int i = 0; i < NUM_RESOURCES; i++) {
-	     	resourceTable[i].totalInstances = INSTANCES_PER_RESOURCE;
-	     	resourceTable[i].availableInstances = INSTANCES_PER_RESOURCE;
-	    	resourceTable[i].head = 0;
-	    	resourceTable[i].tail = 0;
-	       
-		for (int j = 0; j < MAX_PCB; j++) {
-			resourceTable[i].resourceAllocated[j] = 0;
-        		resourceTable[i].requestQueue[j] = -1; // -1 means empty slot in queue
-	       	}
+	double wallBefore = stats.wallSeconds; // Real time of the runs this one resumes, 0 for a fresh run
+
+	if (admission.enabled && !resume) { // Starts wide open at -s and -i, then backs off when congested. A resumed run restored it mid window
+		admissionInit(&admission, simul, interval, &profile, (unsigned long long) clock->seconds * NANO_TO_SEC + clock->nanoseconds);
 	}
-	
+
 	// Main loop
-	while (launched < totalProcesses || activeProcesses > 0) {
+	while (stats.launched < totalProcesses || stats.activeProcesses > 0) {
 		int randomNano = (rand() % 90001) + 10000;
 		incrementClock(clock, 0, randomNano);
+
+		resmgrAccount(&resmgr, randomNano); // Utilization over the time just simulated
+
+		unsigned long long now = (unsigned long long) clock->seconds * NANO_TO_SEC + clock->nanoseconds;
+
+		if (admission.enabled) { // Feedback on launch rate and concurrency
+			admissionSample(&admission, resourceTable, randomNano);
+			if (now - admission.windowStart >= ADMISSION_WINDOW) {
+				char decision[256];
+				if ((admissionUpdate(&admission, now, simul, stats.launched >= totalProcesses, decision, sizeof(decision)) || verbose) && linesWritten < 10000) { // Log every change, holds too with -v
+					fprintf(file, "OSS: Admission at %u:%u %s\n", clock->seconds, clock->nanoseconds, decision);
+					printf("OSS: Admission at %u:%u %s\n", clock->seconds, clock->nanoseconds, decision);
+					linesWritten++;
+				}
+			}
+		}
+		if (checkpointName && (unsaved || now - lastCheckpoint >= CHECKPOINT_INTERVAL)) { // After every change the workers saw, else periodically
+			stats.wallSeconds = wallBefore + wallSince(&wallStart);
+			checkpointSave(&checkpoint);
+			lastCheckpoint = now;
+			unsaved = 0;
+		}
 		
 		if (difftime(time(NULL), startTime) >= 5) { // Track if 5 seconds in REAL TIME has passed.
 		    	printf("OSS: Real-time limit of 5 seconds reached. Terminating simulation.\n");
@@ -185,105 +375,102 @@ int main(int argc, char **argv) {
 		int status; // For checking children that want to terminate.
 		pid_t pid = waitpid(-1, &status, WNOHANG);
 
-		static unsigned int lastDeadlockCheck = 0;
+		if (pid <= 0 && now - lastAdoptedPoll >= ADOPTED_POLL_INTERVAL) { // Adopted workers aren't our children, poll them instead
+			lastAdoptedPoll = now;
+			for (int i = 0; i < MAX_PCB; i++) {
+				if (processTable[i].occupied && processTable[i].adopted && !workerAlive(processTable[i].pid)) {
+					pid = processTable[i].pid;
+					break;
+				}
+			}
+		}
 
-		if (clock->seconds > lastDeadlockCheck) { // Dead lock detection.
-		    	lastDeadlockCheck = clock->seconds; // Last second stored
+		if (clock->seconds > stats.lastDeadlockCheck) { // Dead lock detection.
+		    	stats.lastDeadlockCheck = clock->seconds; // Last second stored
 
-			deadlockDetectedRun++;
+			stats.deadlockDetectedRun++;
 
-			int deadlockFound = 0; // flag if deadlock detected
-		    	int victim = -1; // process that was deadlocked
+			int deadlocked[MAX_PCB]; // Blocked processes whose pending requests can never be met
+			int numDeadlocked = resmgrDetect(&resmgr, deadlocked, now);
+			if (numDeadlocked > 0) {
+				stats.deadlockProcesses++; // Counted once per run, just resolve one per second
+				ResmgrGrant grants[MAX_PCB];
+				int numGranted = 0;
 
-		    	for (int i = 0; i < MAX_PCB; i++) { // Search every process that is active and blocked.
-				if (processTable[i].occupied && processTable[i].blocked) {
-			    		int canBeGranted = 0;
-			    		for (int j = 0; j < NUM_RESOURCES; j++) { // Check if process can be granted resources
-						int need = processTable[i].maxResources[j] - processTable[i].resourceAllocated[j];
-						if (need > 0 && resourceTable[j].availableInstances >= need) {
-				    			canBeGranted = 1;
-				    			break;
-						}
-			    		}
-			    		if (!canBeGranted) { // If resource cannot be allocated, mark it as deadlocked.
-						deadlockFound = 1;
-						victim = i;
-						deadlockProcesses++;
-						break; // just resolve one per second
-			    		}
-				}
-		    	}
+				// Preemption skips protected processes and prefers the least preempted, then the one holding the least.
+				int victim = preempt ? resmgrPreemptVictim(&resmgr, deadlocked, numDeadlocked) : -1;
+				if (victim != -1) { // Take resources back instead of killing
+					if (linesWritten < 10000) {
+						fprintf(file, "OSS: Deadlock detected at time %u:%u. Preempting P%d\n", clock->seconds, clock->nanoseconds, processTable[victim].pid);
+						printf("OSS: Deadlock detected at time %u:%u. Preempting P%d\n", clock->seconds, clock->nanoseconds, processTable[victim].pid);
+						linesWritten++;
+					}
+					numGranted = resmgrPreempt(&resmgr, victim, now, grants);
+
+					OssMSG preemptMsg; // Wakes the worker out of its blocked msgrcv
+					preemptMsg.mtype = processTable[victim].pid;
+					preemptMsg.pid = processTable[victim].pid;
+					preemptMsg.type = MSG_PREEMPT;
+					preemptMsg.resourceID = -1;
+					preemptMsg.quantity = 0;
+					msgsnd(msgid, &preemptMsg, sizeof(OssMSG) - sizeof(long), 0);
+					stats.preemptions++;
+				} else { // Dealing with deadlocked processes, kill takes the cheapest one and preemption falls back to this when every candidate is protected.
+					victim = resmgrKillVictim(&resmgr, deadlocked, numDeadlocked);
+					pid_t victimPid = processTable[victim].pid;
+					if (linesWritten < 10000) {
+						fprintf(file, "OSS: Deadlock detected at time %u:%u. Terminating P%d\n", clock->seconds, clock->nanoseconds, victimPid);
+						printf("OSS: Deadlock detected at time %u:%u. Terminating P%d\n", clock->seconds, clock->nanoseconds, victimPid);
+						linesWritten++;
+					}
 
-			if (deadlockFound && victim != -1) { // Dealing with deadlocked processes.
-				if (linesWritten < 10000) {
-					fprintf(file, "OSS: Deadlock detected at time %u:%u. Terminating P%d\n", clock->seconds, clock->nanoseconds, processTable[victim].pid);
-					printf("OSS: Deadlock detected at time %u:%u. Terminating P%d\n", clock->seconds, clock->nanoseconds, processTable[victim].pid);
-					linesWritten++;
+					// Terminate process and free its PCB. It won't be matched when reaped, so count it out here.
+					numGranted = resmgrUnregister(&resmgr, victim, now, grants);
+					kill(victimPid, SIGTERM);
+					stats.activeProcesses--;
+					stats.deadlockTerminations++;
 				}
-				for (int j = 0; j < NUM_RESOURCES; j++) {
-			    		int released = processTable[victim].resourceAllocated[j];
-			    		if (released > 0) { // Whatever resources that is held by deadlocked process, release.
-						resourceTable[j].availableInstances += released;
-						resourceTable[j].resourceAllocated[victim] = 0;
-						processTable[victim].resourceAllocated[j] = 0;
-			    		}
-				}
-
-				// Terminate process and reset its PCB.
-				kill(processTable[victim].pid, SIGTERM);
-				processTable[victim].occupied = 0;
-				processTable[victim].pid = -1;
-				processTable[victim].blocked = 0;
-				deadlockTerminations++;
-		    	}
+				deliverGrants(msgid, grants, numGranted, file, &linesWritten, verbose, clock); // Freed units may unblock others
+				unsaved = 1;
+			}
 		}
 
-		if (pid > 0) { // Check if child terminated.
-			for (int i = 0; i < MAX_PCB; i++) {
-				if (processTable[i].occupied && processTable[i].pid == pid) { // Free PCB index if free. 
-			                processTable[i].occupied = 0;
-					activeProcesses--;
-					terminations++;
-					if (linesWritten < 10000 && verbose) { // Write to log file
-						fprintf(file, "OSS: Child %d terminated at time %u:%u\n", pid, clock->seconds, clock->nanoseconds);						                                             printf("OSS: Child %d terminated at time %u:%u\n", pid, clock->seconds, clock->nanoseconds);
-						linesWritten++;
-						break;
-					}
-		    		}
+		int pcbIndex = (pid > 0) ? resmgrLookup(&resmgr, pid) : -1;
+		if (pcbIndex != -1) { // Check if child terminated.
+			// Free PCB index. Its last releases may still be queued behind the exit, so whatever it holds goes back now.
+			ResmgrGrant grants[MAX_PCB];
+			int numGranted = resmgrUnregister(&resmgr, pcbIndex, now, grants);
+			stats.activeProcesses--;
+			stats.terminations++;
+			if (linesWritten < 10000 && verbose) { // Write to log file
+				fprintf(file, "OSS: Child %d terminated at time %u:%u\n", pid, clock->seconds, clock->nanoseconds);
+				printf("OSS: Child %d terminated at time %u:%u\n", pid, clock->seconds, clock->nanoseconds);
+				linesWritten++;
 			}
+			deliverGrants(msgid, grants, numGranted, file, &linesWritten, verbose, clock);
+			unsaved = 1;
 		}
 
 		// Launching child 
-		if (launched < totalProcesses && activeProcesses < simul && (clock->seconds * NANO_TO_SEC + clock->nanoseconds) >= nextLaunchTime) {
-			int pcbIndex = -1; // Index for PCB table
-			for (int i = 0; i < MAX_PCB; i++) { // Go through PCB table
-				if (!processTable[i].occupied) { // Find free slot
-					pcbIndex = i;
-					break;
-		    		}
-			}
-
-			if (pcbIndex != -1) { // For slot that is free
-				pid_t childPid = fork(); // Split to user processes
-				if (childPid == 0) { // Worker process
-					execl("./user", "./user", NULL);
-				} else { // Parent process
+		int concurrencyLimit = admission.enabled ? admission.concurrencyLimit : simul;
+		unsigned long long launchInterval = admission.enabled ? admission.launchInterval : (unsigned long long) interval * 1000000;
+		if (stats.launched < totalProcesses && stats.activeProcesses < concurrencyLimit && now >= stats.nextLaunchTime) {
+			int freeIndex = resmgrFindFree(&resmgr); // Index for PCB table
+
+			if (freeIndex != -1) { // For slot that is free
+				pid_t childPid = spawnUser(profileName, seedGiven, seed + stats.launched); // Split to user processes
+				if (childPid > 0) { // Parent process
 					// Update PCB table
-					processTable[pcbIndex].occupied = 1;
-                			processTable[pcbIndex].pid = childPid;
-                			processTable[pcbIndex].startSeconds = clock->seconds;
-                			processTable[pcbIndex].startNano = clock->nanoseconds;
-					
-					// Max resource claim
-					for (int j = 0; j < NUM_RESOURCES; j++) {
-					    	processTable[pcbIndex].maxResources[j] = rand() % (INSTANCES_PER_RESOURCE + 1);
-					}					
+					resmgrRegister(&resmgr, freeIndex, childPid, rand() % NUM_PRIORITIES);
+                			processTable[freeIndex].startSeconds = clock->seconds;
+                			processTable[freeIndex].startNano = clock->nanoseconds;
 
 					// Update variables for next loop			
-					activeProcesses++;
-                			launched++;
+					stats.activeProcesses++;
+                			stats.launched++;
+					unsaved = 1;
                 			
-					nextLaunchTime = clock->seconds * NANO_TO_SEC + clock->nanoseconds + (interval * 1000000); // Set up next user process launch
+					stats.nextLaunchTime = now + launchInterval; // Set up next user process launch
                 			if (linesWritten < 10000 && verbose) {
 						fprintf(file, "OSS: Forked child %d at time %u:%u\n", childPid, clock->seconds, clock->nanoseconds);
 						printf("OSS: Forked child %d at time %u:%u\n", childPid, clock->seconds, clock->nanoseconds);
@@ -296,35 +483,33 @@ int main(int argc, char **argv) {
 		OssMSG msg;
 		while (msgrcv(msgid, &msg, sizeof(OssMSG) - sizeof(long), 0, IPC_NOWAIT) > 0) { // Get message from message queue
 			// Find an active PCB process
-			 int pcbIndex = -1;
-			 for (int i = 0; i < MAX_PCB; i++) {
-			 	 if (processTable[i].occupied && processTable[i].pid == msg.pid) {
-			     		 pcbIndex = i;
-			     		 break;
-			 	 }
-		     	 }
+			 pcbIndex = resmgrLookup(&resmgr, msg.pid);
 
 			 if (pcbIndex == -1) { // If no pcb processes are found
 			 	continue;
 			 }
+			 unsaved = 1; // Every answer below changes what the worker believes
 
 			 int resourceID = msg.resourceID; // Get resource ID from worker.
 
-			if (msg.quantity > 0) { // Request resources
-				totalRequests++; // Update requests amount
+			if (msg.type == MSG_REQUEST) { // Request resources
+				stats.totalRequests++; // Update requests amount
 
-				if (resourceTable[resourceID].availableInstances >= msg.quantity) { // Check if available instances for resource.
-					grantedInstantly++; // Update granted request instantly
+				int result = resmgrRequest(&resmgr, pcbIndex, resourceID, msg.quantity, now);
+				if (result == RESMGR_INVALID) { // Malformed request, nothing to grant or queue. Answer with 0 units so the worker isn't left waiting
+					sendGrant(msgid, pcbIndex, resourceID, 0);
+					continue;
+				}
 
-					resourceTable[resourceID].availableInstances -= msg.quantity; // Granting resource request meaning reducing how much is available once granted.
-			    		resourceTable[resourceID].resourceAllocated[pcbIndex] += msg.quantity; // Update that pcbIndex is holding this resource
-			    		processTable[pcbIndex].resourceAllocated[resourceID] += msg.quantity; // Update PCB table for resource allocated
+				if (result == RESMGR_GRANTED) { // Instances were available and are now held by pcbIndex.
+					stats.grantedInstantly++; // Update granted request instantly
 
 					// Send message to worker
 					OssMSG response;
 			    		// Send message that tells worker that message was granted.		
 					response.mtype = msg.pid;
 					response.pid = msg.pid;
+					response.type = MSG_GRANT;
 			    		response.resourceID = resourceID;
 			    		response.quantity = msg.quantity; // Positive means granted
 			    		msgsnd(msgid, &response, sizeof(OssMSG) - sizeof(long), 0);
@@ -354,98 +539,23 @@ int main(int argc, char **argv) {
                                                 printf("OSS: Process %d requesting R%d x%d at time %u:%u\n", msg.pid, msg.resourceID, msg.quantity, clock->seconds, clock->nanoseconds);
 						linesWritten++;
 					}
-				} else { // In case there's not enough resources to allocate.
-					
-					// Add process to wait queue and block it until resources are allocated.
-					int tail = resourceTable[resourceID].tail;
-			    		resourceTable[resourceID].requestQueue[tail] = pcbIndex;
-			    		resourceTable[resourceID].tail = (tail + 1) % MAX_PCB;
-			    		processTable[pcbIndex].blocked = 1;
-
+				} else { // In case there's not enough resources to allocate, process was queued and blocked until resources are allocated.
 					if (linesWritten < 10000 && verbose) {
 						fprintf(file, "OSS: P%d blocked for R%d at %u:%u\n", msg.pid, resourceID, clock->seconds, clock->nanoseconds);						                                     printf("OSS: P%d blocked for R%d at %u:%u\n", msg.pid, resourceID, clock->seconds, clock->nanoseconds);
 						linesWritten++;
 			    		}
 				}
 			} else { // Releasing Resources
-				resourceID = msg.resourceID;
-				pcbIndex = -1;
-
-				// Find active PCB process 
-				for (int i = 0; i < MAX_PCB; i++) {
-					if (processTable[i].occupied && processTable[i].pid == msg.pid) {
-				    		pcbIndex = i;
-				    		break;
-					}
-				}
-
-				if (pcbIndex == -1) { // If not, skip and continue while loop.
-					continue;
-				}
-				
-				// How much resources is process releasing
-				int amountReleased = processTable[pcbIndex].resourceAllocated[resourceID];
-
-				// Releasing resources.
-				resourceTable[resourceID].availableInstances += amountReleased;
-			    	resourceTable[resourceID].resourceAllocated[pcbIndex] = 0;
-			    	processTable[pcbIndex].resourceAllocated[resourceID] = 0;
+				// Releasing everything held of the resource, then blocked processes that need it are picked by the resource's wake-up policy.
+				ResmgrGrant grants[MAX_PCB];
+				int numGranted = resmgrRelease(&resmgr, pcbIndex, resourceID, now, grants);
 
 				if (linesWritten < 10000 && verbose) {
 					fprintf(file, "OSS: Process %d releasing R%d at time %u:%u\n", msg.pid, msg.resourceID, clock->seconds, clock->nanoseconds);
 					printf("OSS: Process %d releasing R%d at time %u:%u\n", msg.pid, msg.resourceID, clock->seconds, clock->nanoseconds);
 					linesWritten++;
 				}
-
-				// For process that are blocked that need the resource. 
-				
-				int head = resourceTable[resourceID].head;
-				int tail = resourceTable[resourceID].tail;
-				
-				while (head != tail) { // Run through every blocked process
-
-					int blockedIndex = resourceTable[resourceID].requestQueue[head];
-					
-					if (blockedIndex == -1) { // Check if resourceQueue is empty, if so, continue.
-						head = (head + 1) % MAX_PCB;
-						continue;
-					}
-					
-					// Determine how much resource the blocked process wants. 
-					int maxAllowed = processTable[blockedIndex].maxResources[resourceID];
-					int alreadyHeld = processTable[blockedIndex].resourceAllocated[resourceID];
-					int remainingRequest = maxAllowed - alreadyHeld;
-
-					if (resourceTable[resourceID].availableInstances >= remainingRequest && remainingRequest > 0) { // Grant request
-						// Allocating resources to process 
-						resourceTable[resourceID].availableInstances -= remainingRequest;
-						resourceTable[resourceID].resourceAllocated[blockedIndex] += remainingRequest;
-						processTable[blockedIndex].resourceAllocated[resourceID] += remainingRequest;
-						processTable[blockedIndex].blocked = 0;
-
-						// Send message indicating request granted
-						OssMSG response;
-						response.mtype = processTable[blockedIndex].pid;
-						response.pid = processTable[blockedIndex].pid;
-						response.resourceID = resourceID;
-						response.quantity = remainingRequest;
-						msgsnd(msgid, &response, sizeof(OssMSG) - sizeof(long), 0);
-				    
-						grantedAfterWait++; // Update for requests that will be granted after being blocked.
-
-						if (linesWritten < 10000 && verbose) {
-							fprintf(file, "OSS: Unblocked P%d with R%d (%d units) at %u:%u\n", processTable[blockedIndex].pid, resourceID, remainingRequest, clock->seconds, clock->nanoseconds);
-                                                        printf("OSS: Unblocked P%d with R%d (%d units) at %u:%u\n", processTable[blockedIndex].pid, resourceID, remainingRequest, clock->seconds, clock->nanoseconds);
-							linesWritten++;
-				    		}
-
-						resourceTable[resourceID].requestQueue[head] = -1; // Mark this queue slot as empty since request is granted 
-					}
-
-					head = (head + 1) % MAX_PCB; // Move forward to next blocked process 
-				}
-
-				resourceTable[resourceID].head = head; // Update queue head.
+				deliverGrants(msgid, grants, numGranted, file, &linesWritten, verbose, clock);
 			}
 		}
 		
@@ -500,56 +610,65 @@ int main(int argc, char **argv) {
 	}
 
 	double averageTerminations = 0.0;
-	if (deadlockProcesses > 0) {
-		averageTerminations = ((double) deadlockTerminations / deadlockProcesses) * 100;
+	if (stats.deadlockProcesses > 0) {
+		averageTerminations = ((double) stats.deadlockTerminations / stats.deadlockProcesses) * 100;
+	}
+
+	// Completed work per second, to compare deadlock strategies across runs
+	stats.wallSeconds = wallBefore + wallSince(&wallStart); // Time oss was down between runs isn't counted
+	double wallSeconds = stats.wallSeconds;
+	double simSeconds = clock->seconds + clock->nanoseconds / 1e9;
+	int grants = stats.grantedInstantly + stats.grantedAfterWait;
+	char *strategy = preempt ? "preempt" : "kill";
+	char admissionSummary[128] = "off";
+	if (admission.enabled) {
+		snprintf(admissionSummary, sizeof(admissionSummary), "limit %d, interval %.1f ms, %d adjustments", admission.concurrencyLimit, admission.launchInterval / 1e6, admission.adjustments);
 	}
 
 	// Log statistics statistics
 	fprintf(file, "\nSIMULATION SUMMARY\n");
-	fprintf(file, "Total Requests: %d\n", totalRequests);
-	fprintf(file, "Granted Instantly: %d\n", grantedInstantly);
-	fprintf(file, "Granted After Wait: %d\n", grantedAfterWait);
-	fprintf(file, "Deadlock Detection Runs: %d\n", deadlockDetectedRun);
-	fprintf(file, "Total Deadlocked Processes Detected: %d\n", deadlockProcesses);
-	fprintf(file, "Processes Terminated due to Deadlock: %d\n", deadlockTerminations);
-	fprintf(file, "Processes Terminated Normally: %d\n", terminations);	
+	fprintf(file, "Total Requests: %d\n", stats.totalRequests);
+	fprintf(file, "Granted Instantly: %d\n", stats.grantedInstantly);
+	fprintf(file, "Granted After Wait: %d\n", stats.grantedAfterWait);
+	fprintf(file, "Deadlock Detection Runs: %d\n", stats.deadlockDetectedRun);
+	fprintf(file, "Total Deadlocked Processes Detected: %d\n", stats.deadlockProcesses);
+	fprintf(file, "Processes Terminated due to Deadlock: %d\n", stats.deadlockTerminations);
+	fprintf(file, "Processes Terminated Normally: %d\n", stats.terminations);	
 	fprintf(file, "%% of Deadlocked Processes Terminated: %.2f%%\n", averageTerminations);	
+	fprintf(file, "Deadlock Strategy: %s\n", strategy);
+	fprintf(file, "Deadlocks Resolved by Preemption: %d\n", stats.preemptions);
+	fprintf(file, "Completed Processes per Second: %.2f real, %.2f simulated\n", stats.terminations / wallSeconds, simSeconds > 0 ? stats.terminations / simSeconds : 0.0);
+	fprintf(file, "Grants per Second: %.2f real, %.2f simulated\n", grants / wallSeconds, simSeconds > 0 ? grants / simSeconds : 0.0);
+	fprintf(file, "Admission Control: %s\n", admissionSummary);
+	resmgrPrintWaitStats(&resmgr, file);
 	
 	// Print statistics
         printf("\nSIMULATION SUMMARY\n");
-        printf("Total Requests: %d\n", totalRequests);
-        printf("Granted Instantly: %d\n", grantedInstantly);
-        printf("Granted After Wait: %d\n", grantedAfterWait);
-        printf("Deadlock Detection Runs: %d\n", deadlockDetectedRun);
-        printf("Total Deadlocked Processes Detected: %d\n", deadlockProcesses);
-        printf("Processes Terminated due to Deadlock: %d\n", deadlockTerminations);
-        printf("Processes Terminated Normally: %d\n", terminations);
+        printf("Total Requests: %d\n", stats.totalRequests);
+        printf("Granted Instantly: %d\n", stats.grantedInstantly);
+        printf("Granted After Wait: %d\n", stats.grantedAfterWait);
+        printf("Deadlock Detection Runs: %d\n", stats.deadlockDetectedRun);
+        printf("Total Deadlocked Processes Detected: %d\n", stats.deadlockProcesses);
+        printf("Processes Terminated due to Deadlock: %d\n", stats.deadlockTerminations);
+        printf("Processes Terminated Normally: %d\n", stats.terminations);
         printf("%% of Deadlocked Processes Terminated: %.2f%%\n", averageTerminations);
+	printf("Deadlock Strategy: %s\n", strategy);
+	printf("Deadlocks Resolved by Preemption: %d\n", stats.preemptions);
+	printf("Completed Processes per Second: %.2f real, %.2f simulated\n", stats.terminations / wallSeconds, simSeconds > 0 ? stats.terminations / simSeconds : 0.0);
+	printf("Grants per Second: %.2f real, %.2f simulated\n", grants / wallSeconds, simSeconds > 0 ? grants / simSeconds : 0.0);
+	printf("Admission Control: %s\n", admissionSummary);
+	resmgrPrintWaitStats(&resmgr, stdout);
+
+	if (stats.launched >= totalProcesses && stats.activeProcesses == 0) { // Every process ran to the end
+		checkpointFinish(&checkpoint);
+	} else { // Stopped by the real-time limit, keep it resumable
+		checkpointSave(&checkpoint);
+	}
+	checkpointClose(&checkpoint);
 
-	// Detach shared memory
-    	if (shmdt(clock) == -1) {
-        	printf("Error: OSS Shared memory detachment failed \n");
-		exit(1);
-    	}
-	
-	// Detach shared memory for resource table
-	if (shmdt(resourceTable) == -1) {
-                printf("Error: OSS Shared memory detachment failed \n");
-                exit(1);
-        }
-
-
-    	// Remove shared memory
-    	if (shmctl(shmid, IPC_RMID, NULL) == -1) {
-        	printf("Error: Removing memory failed \n");
-		exit(1);
-    	}
-
-	// Remove shared memory for resource table
-	if (shmctl(shmResourceID, IPC_RMID, NULL) == -1) {
-                printf("Error: Removing memory failed \n");
-                exit(1);
-        }
+	// Detach and remove shared memory
+	regionDetach(&mapping);
+	regionRemove();
 
 	// Remove message queue
 	if (msgctl(msgid, IPC_RMID, NULL) == -1) {
@@ -571,7 +690,191 @@ void incrementClock(SimulatedClock *clock, int addSec, int addNano) { // This fu
 }
 
 
+pid_t spawnUser(char *profileName, int seedGiven, unsigned int childSeed) {
+	pid_t childPid = fork();
+	if (childPid == 0) { // Worker process
+		if (seedGiven) { // Each child gets its own seed derived from the run seed
+			char seedArg[16];
+			snprintf(seedArg, sizeof(seedArg), "%u", childSeed);
+			execl("./user", "./user", profileName, seedArg, NULL);
+		} else {
+			execl("./user", "./user", profileName, NULL);
+		}
+		printf("Error: exec of ./user failed. \n");
+		exit(1);
+	}
+	return childPid;
+}
+
+int workerAlive(pid_t pid) {
+	if (kill(pid, 0) == -1 && errno == ESRCH) {
+		return 0;
+	}
+
+	// kill() still succeeds on a zombie nobody has reaped yet, so look at its state when /proc is there.
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%d/stat", (int) pid);
+	FILE *statFile = fopen(path, "r");
+	if (!statFile) {
+		return 1;
+	}
+
+	char state = 0;
+	int fields = fscanf(statFile, "%*d %*s %c", &state);
+	fclose(statFile);
+	return !(fields == 1 && state == 'Z');
+}
+
+void sendGrant(int msgid, int pcbIndex, int resourceID, int quantity) {
+	OssMSG response;
+	response.mtype = processTable[pcbIndex].pid;
+	response.pid = processTable[pcbIndex].pid;
+	response.type = MSG_GRANT;
+	response.resourceID = resourceID;
+	response.quantity = quantity; // Positive means granted, 0 rejected
+	msgsnd(msgid, &response, sizeof(OssMSG) - sizeof(long), 0);
+}
+
+void deliverGrants(int msgid, ResmgrGrant *grants, int numGranted, FILE *file, int *linesWritten, int verbose, SimulatedClock *clock) {
+	for (int i = 0; i < numGranted; i++) {
+		int blockedIndex = grants[i].pcbIndex;
+
+		// Send message indicating request granted
+		sendGrant(msgid, blockedIndex, grants[i].resourceID, grants[i].quantity);
+		stats.grantedAfterWait++; // Update for requests that will be granted after being blocked.
+
+		if (*linesWritten < 10000 && verbose) {
+			fprintf(file, "OSS: Unblocked P%d with R%d (%d units) at %u:%u\n", processTable[blockedIndex].pid, grants[i].resourceID, grants[i].quantity, clock->seconds, clock->nanoseconds);
+			printf("OSS: Unblocked P%d with R%d (%d units) at %u:%u\n", processTable[blockedIndex].pid, grants[i].resourceID, grants[i].quantity, clock->seconds, clock->nanoseconds);
+			(*linesWritten)++;
+		}
+	}
+}
+
+void admissionInit(AdmissionControl *admission, int simul, int interval, WorkloadProfile *profile, unsigned long long now) {
+	memset(admission, 0, sizeof(AdmissionControl));
+	admission->enabled = 1;
+	for (int i = 0; i < profile->numPhases; i++) { // A waiter is slow once it waits longer than a holder of the slowest phase keeps its units
+		WorkloadPhase *phase = &profile->phases[i];
+		int releaseChance = (phase->requestProbability < 100) ? 100 - phase->requestProbability : 1; // % of actions that release
+		unsigned long long hold = phase->meanHold + phase->meanInterArrival * 100 / releaseChance;
+		if (hold > admission->latencyLimit) {
+			admission->latencyLimit = hold;
+		}
+	}
+	admission->concurrencyLimit = simul;
+	admission->launchInterval = (unsigned long long) interval * 1000000;
+	admission->minInterval = (admission->launchInterval / 4 > 1000000) ? admission->launchInterval / 4 : 1000000; // Never faster than 1 ms
+	admission->maxInterval = admission->launchInterval * 8;
+	admission->windowStart = now;
+	admission->lastAction = ADMIT_HOLD;
+	admission->deadlocksAtStart = stats.deadlockProcesses; // Counters may be non zero after a resume
+	admission->terminationsAtStart = stats.terminations;
+	for (int i = 0; i < NUM_WAKE_POLICIES; i++) {
+		admission->wokenAtStart += stats.waitStats[i].count;
+		admission->waitAtStart += stats.waitStats[i].totalWait;
+	}
+}
+
+void admissionSample(AdmissionControl *admission, ResourceDesc *resourceTable, int elapsed) {
+	int active = 0;
+	int blocked = 0;
+	for (int i = 0; i < MAX_PCB; i++) {
+		if (processTable[i].occupied) {
+			active++;
+			blocked += processTable[i].blocked;
+		}
+	}
+	admission->activeTime += (double) active * elapsed;
+	admission->blockedTime += (double) blocked * elapsed;
+
+	for (int i = 0; i < NUM_RESOURCES; i++) {
+		admission->busyTime += (double) (resourceTable[i].totalInstances - resourceTable[i].availableInstances) * elapsed;
+		admission->capacityTime += (double) resourceTable[i].totalInstances * elapsed;
+	}
+}
+
+// Backs off multiplicatively on congestion (most processes blocked on saturated resources or with nobody woken, a deadlock, grants slower
+// than the profile holds units) or when the last increase cost throughput, and opens up additively while resources have room. Aims at
+// completed processes per second, so a cut that didn't raise throughput isn't repeated, the congestion is then in processes already running
+// and fewer launches only starve the run. Once every process is launched (draining) completions only tail off, so it just holds.
+int admissionUpdate(AdmissionControl *admission, unsigned long long now, int simul, int draining, char *decision, int size) {
+	int woken = 0;
+	unsigned long long waited = 0;
+	for (int i = 0; i < NUM_WAKE_POLICIES; i++) {
+		woken += stats.waitStats[i].count;
+		waited += stats.waitStats[i].totalWait;
+	}
+
+	double window = (double) (now - admission->windowStart) / NANO_TO_SEC;
+	double blockedFraction = (admission->activeTime > 0) ? admission->blockedTime / admission->activeTime : 0.0;
+	double utilization = (admission->capacityTime > 0) ? admission->busyTime / admission->capacityTime : 0.0;
+	int deadlocks = stats.deadlockProcesses - admission->deadlocksAtStart;
+	int grantsAfterWait = woken - admission->wokenAtStart;
+	double latency = grantsAfterWait ? (double) (waited - admission->waitAtStart) / grantsAfterWait : 0.0;
+	double throughput = (stats.terminations - admission->terminationsAtStart) / window;
+	throughput = (admission->lastThroughput > 0) ? (admission->lastThroughput + throughput) / 2 : throughput; // Smooth, a window only sees a few completions
+	double noise = sqrt(admission->lastThroughput / window); // Completions are roughly Poisson, one standard deviation of the rate is noise
+
+	int oldLimit = admission->concurrencyLimit;
+	unsigned long long oldInterval = admission->launchInterval;
+	int congested = (blockedFraction > ADMISSION_BLOCKED_HIGH && (utilization >= ADMISSION_UTILIZATION_TARGET || grantsAfterWait == 0)) || deadlocks > 0
+			|| latency > admission->latencyLimit;
+	int regressed = admission->lastAction == ADMIT_INCREASE && admission->lastThroughput > 0 && throughput < admission->lastThroughput - noise;
+	int stalled = admission->lastAction == ADMIT_DECREASE && throughput <= admission->lastThroughput + noise;
+	int active = 0;
+	for (int i = 0; i < MAX_PCB; i++) {
+		active += processTable[i].occupied;
+	}
+
+	int action = ADMIT_HOLD;
+	if (draining) {
+		// Nothing left to launch, the limit and interval no longer matter
+	} else if ((congested && !stalled) || regressed) {
+		action = ADMIT_DECREASE;
+		admission->concurrencyLimit = (oldLimit * 3 / 4 < oldLimit - 1) ? oldLimit * 3 / 4 : oldLimit - 1;
+		if (admission->concurrencyLimit < active / 2) { // Blocked processes that are already running don't clear faster with a lower limit, so don't collapse below half of them
+			admission->concurrencyLimit = active / 2;
+		}
+		if (admission->concurrencyLimit < 1) { // Always keep one process going
+			admission->concurrencyLimit = (simul > 0) ? 1 : 0;
+		}
+		admission->launchInterval = (oldInterval * 2 < admission->maxInterval) ? oldInterval * 2 : admission->maxInterval;
+	} else if (!congested && utilization < ADMISSION_UTILIZATION_TARGET) { // A congested window whose last cut didn't help holds, growing would only be undone next window
+		action = ADMIT_INCREASE;
+		admission->concurrencyLimit = (oldLimit < simul) ? oldLimit + 1 : simul;
+		admission->launchInterval = (oldInterval * 3 / 4 > admission->minInterval) ? oldInterval * 3 / 4 : admission->minInterval;
+	}
+
+	int changed = admission->concurrencyLimit != oldLimit || admission->launchInterval != oldInterval;
+	if (changed) {
+		admission->adjustments++;
+	}
+
+	snprintf(decision, size, "blocked %.2f util %.2f deadlocks %d latency %.1fms throughput %.2f/s -> %s, limit %d interval %.1fms",
+			blockedFraction, utilization, deadlocks, latency / 1e6, throughput,
+			action == ADMIT_DECREASE ? (regressed && !congested ? "decrease (throughput fell)" : "decrease") : (action == ADMIT_INCREASE ? "increase"
+			: (draining ? "hold (draining)" : (congested ? "hold (last cut didn't help)" : "hold"))),
+			admission->concurrencyLimit, admission->launchInterval / 1e6);
+
+	// Start the next window
+	admission->lastAction = changed ? action : ADMIT_HOLD;
+	admission->lastThroughput = throughput;
+	admission->windowStart = now;
+	admission->blockedTime = 0;
+	admission->activeTime = 0;
+	admission->busyTime = 0;
+	admission->capacityTime = 0;
+	admission->deadlocksAtStart = stats.deadlockProcesses;
+	admission->terminationsAtStart = stats.terminations;
+	admission->wokenAtStart = woken;
+	admission->waitAtStart = waited;
+	return changed;
+}
+
 void signalHandler(int sig) { // Signal handler
+	checkpointClose(&checkpoint); // Last periodic snapshot stays on disk so the run can be resumed with -R, saving here could catch the tables mid update
+
        	// Catching signal
 	if (sig == SIGALRM) { // 60 seconds have passed
 	       	fprintf(stderr, "Alarm signal caught, terminating all processes.\n");
@@ -586,22 +889,8 @@ void signalHandler(int sig) { // Signal handler
 	    	}
 	}
 
-	// Cleanup shared memory
-    	int shmid = shmget(SHM_KEY, sizeof(SimulatedClock), 0666);
-    	if (shmid != -1) {
-		SimulatedClock *clock = (SimulatedClock *)shmat(shmid, NULL, 0);
-		if (clock != (void *)-1) { // Detach shared memory
-			if (shmdt(clock) == -1) {
-				printf("Error: OSS Shared memory detachment failed \n");
-				exit(1);
-			}
-		}
-		// Remove shared memory
-		if (shmctl(shmid, IPC_RMID, NULL) == -1) {
-                	printf("Error: Removing memory failed \n");
-                	exit(1);
-        	}
-	}
+	// Cleanup shared memory, the mapping itself goes away on exit
+	regionRemove();
 
 	// Cleanup message queue
     	int msgid = msgget(MSG_KEY, 0666);
@@ -611,28 +900,44 @@ void signalHandler(int sig) { // Signal handler
 		       	exit(1);
 	       	}
        	}
-	
-	// Cleanup resource descriptor
-	int shmResourceID = shmget(RESOURCE_KEY, sizeof(ResourceDesc) * NUM_RESOURCES, 0666);
-	if (shmResourceID != -1) {
-	    	ResourceDesc *resourceTable = (ResourceDesc *)shmat(shmResourceID, NULL, 0);
-	    	if (resourceTable != (void *)-1) {
-			shmdt(resourceTable);
-	    	}
-	    	shmctl(shmResourceID, IPC_RMID, NULL);
-	}
-
 
 	exit(1);
 }
 
 void help() {
-	printf("Usage: ./oss [-h] [-n proc] [-s simul] [-i interval] [-f logfile] [-v]\n");
+	printf("Usage: ./oss [-h] [-n proc] [-s simul] [-i interval] [-f logfile] [-p profile] [-r seed] [-c file] [-R] [-O] [-H] [-w policy] [-d strategy] [-a] [-v]\n");
     	printf("Options:\n");
     	printf("-h 	      Show this help message and exit.\n");
     	printf("-n proc       Total number of user processes to launch (default: 40).\n");
     	printf("-s simul      Maximum number of simultaneous processes (max: 18).\n");
     	printf("-i interval   Time interval (ms) between process launches (default: 500).\n");
 	printf("-f logfile    Name of the log file to write output (default: oss.log).\n");
+    	printf("-p profile    Workload profile for user processes, a built in name or a profile file (default: default).\n");
+	printf("              Built in profiles: ");
+	listProfiles(stdout);
+	printf("\n");
+	printf("-r seed       Seed oss and every user process for repeatable runs.\n");
+	printf("-c file       Snapshot oss state to this memory mapped checkpoint file every 0.1 simulated seconds.\n");
+	printf("-H            Back the shared region with huge pages, falls back to normal pages if unavailable.\n");
+	printf("-R            Resume from the checkpoint file given with -c, re-adopting or respawning workers.\n");
+	printf("              The run keeps the -n, -s, -i, -p, -r, -w, -d and -a it was started with.\n");
+	printf("-O            Start over with -c even if the checkpoint file holds a snapshot.\n");
+	printf("-w policy     Wake-up policy for blocked requests: ring (default), fifo, smallest or aging.\n");
+	printf("              A comma separated list sets one per resource, e.g. fifo,fifo,aging.\n");
+	printf("-d strategy   Deadlock resolution: kill (default) terminates the victim, preempt takes its resources back so it can retry.\n");
+	printf("-a            Adapt launch interval and concurrency (starting from -i and -s) to blocking, utilization, deadlocks and grant latency.\n");
     	printf("-v            Enable verbose output to both screen and file.\n");
 }
+
+int checkPolicies(char *list) {
+	ResourceDesc scratch[NUM_RESOURCES]; // resmgrSetPolicies only writes wakePolicy, the real table doesn't exist yet
+	ResourceManager check;
+	resmgrInit(&check, NULL, scratch, NULL);
+	return resmgrSetPolicies(&check, list);
+}
+
+double wallSince(struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
@@ -4,15 +4,30 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/msg.h>
-#include <sys/shm.h> // For shared memory
+#include <stddef.h> // For offsetof
 
 
-#define SHM_KEY 856050
+#define SHM_NAME "/oss_shared" // POSIX shared memory object holding the clock and resource table
 #define MSG_KEY 875010
-#define RESOURCE_KEY 886121
+#define CACHE_LINE_SIZE 64
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
 #define MAX_PCB 20
+#define QUEUE_SLOTS (MAX_PCB + 1) // Wait queue ring size, a ring with head == tail as empty needs a spare slot to hold every process
 #define NUM_RESOURCES 5
 #define INSTANCES_PER_RESOURCE 10
+#define WAKE_RING 0 // Original behaviour, first waiter in ring order whose request fits
+#define WAKE_FIFO 1 // Strict FIFO, the head waiter holds freed units back until its request fits
+#define WAKE_SMALLEST 2 // Smallest pending request that fits goes first
+#define WAKE_AGING 3 // Highest priority first, priority grows the longer a process waits
+#define NUM_WAKE_POLICIES 4
+#define NUM_PRIORITIES 4 // Base priorities 0 (lowest) to 3 handed out at launch
+#define WAIT_SAMPLES 1024 // Wait times kept per policy for percentiles
+#define WAIT_BUCKETS 6 // Wait time histogram buckets, bounds in resmgr.c
+#define PREEMPT_LIMIT 3 // A process preempted this many times is never picked as a preemption victim again and is first in every wait queue
+#define MSG_REQUEST 1 // Worker asks for quantity units of resourceID
+#define MSG_RELEASE 2 // Worker gives back everything it holds of resourceID
+#define MSG_GRANT 3 // oss granted quantity units of resourceID
+#define MSG_PREEMPT 4 // oss took back everything the worker held, it rolls back and requests again
 
 // Author: Dat Nguyen
 // oss.h is a header file that holds our structures and some of our constant definitions, useful for cleanliness of oss.c
@@ -29,22 +44,92 @@ typedef struct PCB { // PCB structure, subject to change
         int startSeconds;
         int startNano;
 	int resourceAllocated[NUM_RESOURCES]; // Track resources
-	int maxResources[NUM_RESOURCES]; // Max resource amount for process
 	int blocked; // See if process is waiting for resource 
+	int adopted; // Restored from a checkpoint while still alive, not our child so it can't be waited on
+	int priority; // Base priority for the aging wake-up policy, NUM_PRIORITIES once preempted
+	int pendingResource; // Resource the process is blocked on
+	int pendingQuantity; // Units it asked for when it blocked
+	unsigned long long blockedAt; // Simulated time it blocked
+	int preemptCount; // Times its resources were taken back to break a deadlock
 } PCB;
 
-typedef struct ResourceDesc { // Resource structure, each object represents a resource.
-    int totalInstances; // How many instances of this resource exist
+typedef struct ResourceDesc { // Resource structure, each object represents a resource. Only oss touches it, children just read the clock.
+    // Laid out by how oss writes it. Every grant and release writes availableInstances and resourceAllocated[pcb] together, so they share the
+    // first cache line (for the first 15 PCB slots), and a block writes tail and requestQueue[tail]. Each entry starts its own line so resources don't false share.
     int availableInstances; // Free instances 
     int resourceAllocated[MAX_PCB]; // How many instances each process is holding
-    int requestQueue[MAX_PCB]; // What processes are waiting for this resource
     int head; // Start of resource queue
     int tail; // End of resource queue
-} ResourceDesc;
+    int requestQueue[QUEUE_SLOTS]; // What processes are waiting for this resource
+    int totalInstances; // How many instances of this resource exist, only read after setup
+    int wakePolicy; // WAKE_* policy used to pick waiters when instances free up, only read after setup
+} __attribute__((aligned(CACHE_LINE_SIZE))) ResourceDesc;
+
+typedef struct SharedRegion { // Everything oss shares with its children, mapped from SHM_NAME
+	SimulatedClock clock __attribute__((aligned(CACHE_LINE_SIZE))); // Rewritten every oss loop and read constantly by children, so it gets a line to itself
+	ResourceDesc resourceTable[NUM_RESOURCES] __attribute__((aligned(CACHE_LINE_SIZE)));
+	// Future ring buffers go after the resource table, each aligned to CACHE_LINE_SIZE.
+} SharedRegion;
+
+// Layout checks, a change that breaks the cache line separation fails the build.
+_Static_assert(offsetof(SharedRegion, clock) % CACHE_LINE_SIZE == 0, "clock must start a cache line");
+_Static_assert(offsetof(SharedRegion, resourceTable) - offsetof(SharedRegion, clock) >= CACHE_LINE_SIZE, "clock must be alone on its cache line");
+_Static_assert(offsetof(ResourceDesc, resourceAllocated) < CACHE_LINE_SIZE, "grant counters must start on the line holding availableInstances");
+_Static_assert(offsetof(ResourceDesc, requestQueue) - offsetof(ResourceDesc, tail) == sizeof(int), "queue tail must sit next to the queue it indexes");
+_Static_assert(sizeof(ResourceDesc) % CACHE_LINE_SIZE == 0, "resources must not share cache lines");
+
+typedef struct WaitStats { // Wait times and utilization of resources under one wake-up policy
+	int count; // Requests granted after waiting
+	unsigned long long totalWait; // Simulated ns
+	unsigned long long maxWait;
+	int histogram[WAIT_BUCKETS];
+	unsigned int samples[WAIT_SAMPLES]; // Wait times in microseconds, reservoir sampled once full
+	unsigned long long busyTime; // Allocated units times simulated ns
+	unsigned long long capacityTime; // Total units times simulated ns
+} WaitStats;
+
+typedef struct OssStats { // Counters and launch state oss keeps for the run, everything the summary needs
+	int launched; // Processes launched so far
+	int activeProcesses; // Processes currently running
+	unsigned long long nextLaunchTime; // Simulated time of the next launch
+	unsigned int lastDeadlockCheck; // Simulated second of the last deadlock detection run
+	int totalRequests;
+	int grantedInstantly;
+	int grantedAfterWait;
+	int deadlockDetectedRun;
+	int deadlockTerminations;
+	int deadlockProcesses;
+	int terminations;
+	int preemptions; // Deadlocks resolved by taking resources back instead of killing
+	double wallSeconds; // Real time run up to the last snapshot, earlier runs included, so rates stay right after a resume
+	WaitStats waitStats[NUM_WAKE_POLICIES];
+} OssStats;
+
+typedef struct AdmissionControl { // Feedback controller for process launches, see admissionUpdate() in oss.c
+	int enabled;
+	int concurrencyLimit; // Processes allowed to run at once, between 1 and -s
+	unsigned long long launchInterval; // Simulated ns between launches
+	unsigned long long minInterval;
+	unsigned long long maxInterval;
+	unsigned long long windowStart; // Simulated time the current window began
+	double blockedTime; // Blocked processes times ns over the window
+	double activeTime; // Active processes times ns over the window
+	double busyTime; // Allocated units times ns over the window
+	double capacityTime; // Total units times ns over the window
+	int deadlocksAtStart; // Counters at the start of the window, to take deltas
+	int terminationsAtStart;
+	int wokenAtStart;
+	unsigned long long waitAtStart;
+	unsigned long long latencyLimit; // Mean grant latency that counts as congestion, how long a holder keeps units under the workload profile
+	int lastAction; // ADMIT_* decision of the previous window
+	double lastThroughput; // Smoothed completed processes per simulated second up to the previous window
+	int adjustments; // Windows where the limit or interval changed
+} AdmissionControl;
 
 typedef struct OssMSG { // Message system
 	long mtype;
 	pid_t pid;
+	int type; // MSG_* kind of message
 	int resourceID;
 	int quantity;
 } OssMSG;
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "region.h"
+
+// region.c maps the shared region with shm_open/mmap. The object is created once by oss and sized to whole pages, children look the size up with fstat.
+
+static size_t roundUp(size_t size, size_t unit) {
+	return (size + unit - 1) / unit * unit;
+}
+
+int regionCreate(RegionMapping *mapping, int hugePages) {
+	mapping->region = NULL;
+	mapping->size = 0;
+	mapping->hugePages = 0;
+
+	if (sizeof(SharedRegion) >= HUGE_PAGE_SIZE) { // Large tables, worth a huge page even if not asked for
+		hugePages = 1;
+	}
+
+	int fd = shm_open(SHM_NAME, O_RDWR | O_CREAT, 0666); // No O_EXCL, a resumed oss reuses the region adopted workers still have mapped
+	if (fd == -1) {
+		return -1;
+	}
+
+	size_t size = roundUp(sizeof(SharedRegion), hugePages ? HUGE_PAGE_SIZE : (size_t) sysconf(_SC_PAGESIZE));
+	if (ftruncate(fd, size) == -1) {
+		close(fd);
+		return -1;
+	}
+
+	void *map = MAP_FAILED;
+#ifdef MAP_HUGETLB
+	if (hugePages) { // Only works when the object lives on hugetlbfs, tmpfs backed /dev/shm refuses it
+		map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_HUGETLB, fd, 0);
+		if (map != MAP_FAILED) {
+			mapping->hugePages = 1;
+		}
+	}
+#endif
+	if (map == MAP_FAILED) {
+		map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+#ifdef MADV_HUGEPAGE
+		if (map != MAP_FAILED && hugePages && madvise(map, size, MADV_HUGEPAGE) == 0) { // Fall back to transparent huge pages for shmem
+			mapping->hugePages = 2;
+		}
+#endif
+	}
+	close(fd); // Mapping keeps the object alive
+
+	if (map == MAP_FAILED) {
+		return -1;
+	}
+
+	mapping->region = (SharedRegion *) map;
+	mapping->size = size;
+	return 0;
+}
+
+int regionAttach(RegionMapping *mapping) {
+	mapping->region = NULL;
+	mapping->size = 0;
+	mapping->hugePages = 0;
+
+	int fd = shm_open(SHM_NAME, O_RDWR, 0666);
+	if (fd == -1) {
+		return -1;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) == -1 || (size_t) info.st_size < sizeof(SharedRegion)) { // Not created yet or from another build
+		close(fd);
+		return -1;
+	}
+
+	void *map = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return -1;
+	}
+
+	mapping->region = (SharedRegion *) map;
+	mapping->size = info.st_size;
+	return 0;
+}
+
+void regionDetach(RegionMapping *mapping) {
+	if (mapping->region) {
+		munmap(mapping->region, mapping->size);
+		mapping->region = NULL;
+	}
+}
+
+void regionRemove() {
+	shm_unlink(SHM_NAME);
+}
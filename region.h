@@ -0,0 +1,21 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include "oss.h"
+
+// region.h sets up the POSIX shared memory region (SharedRegion in oss.h) oss creates and user processes attach to.
+
+typedef struct RegionMapping { // A mapped region and how it was mapped
+	SharedRegion *region;
+	size_t size; // Mapped length, rounded up to the page size used
+	int hugePages; // 1 if backed by MAP_HUGETLB, 2 if only advised to use transparent huge pages, 0 otherwise
+} RegionMapping;
+
+// Create (or reopen after a crash) and map the region. With hugePages set, or when the region is at least HUGE_PAGE_SIZE, huge pages are tried first
+// and normal pages are used if the system can't provide them. Returns 0 on success, -1 on failure.
+int regionCreate(RegionMapping *mapping, int hugePages);
+int regionAttach(RegionMapping *mapping); // Map an existing region from a child, returns 0 on success, -1 on failure.
+void regionDetach(RegionMapping *mapping);
+void regionRemove(); // Unlink the region name, mappings stay valid until detached
+
+#endif
@@ -0,0 +1,497 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "resmgr.h"
+
+#define AGING_STEP 100000000 // Aging policy adds one priority level per 0.1 simulated seconds waited
+#define AGING_RESERVE 500000000 // After 0.5 simulated seconds a waiter holds freed units back until it fits
+
+// resmgr.c holds the allocator oss used to run inline: grants, releases, the per resource wait queues and the policies that pick who to
+// wake, deadlock detection, and reclaiming a victim's resources. Queues are rings of PCB indexes in ResourceDesc, -1 marks a hole.
+
+// Wake-up policies pick the queue slot of the next waiter to try, or -1 to stop. If the picked waiter doesn't fit, waking stops so it keeps its place.
+typedef int (*WakeSelect)(ResourceManager *rm, ResourceDesc *resource, unsigned long long now);
+static int selectRing(ResourceManager *rm, ResourceDesc *resource, unsigned long long now);
+static int selectFifo(ResourceManager *rm, ResourceDesc *resource, unsigned long long now);
+static int selectSmallest(ResourceManager *rm, ResourceDesc *resource, unsigned long long now);
+static int selectAging(ResourceManager *rm, ResourceDesc *resource, unsigned long long now);
+
+static WakeSelect wakeSelectors[NUM_WAKE_POLICIES] = { selectRing, selectFifo, selectSmallest, selectAging };
+char *wakePolicyNames[NUM_WAKE_POLICIES] = { "ring", "fifo", "smallest", "aging" };
+static unsigned long long waitBucketBounds[WAIT_BUCKETS - 1] = { 10000000, 50000000, 100000000, 500000000, 1000000000 }; // Last bucket is 1s and up
+
+void resmgrInit(ResourceManager *rm, PCB *processTable, ResourceDesc *resourceTable, WaitStats *waitStats) {
+	rm->processTable = processTable;
+	rm->resourceTable = resourceTable;
+	rm->waitStats = waitStats;
+}
+
+void resmgrReset(ResourceManager *rm) {
+	for (int i = 0; i < MAX_PCB; i++) {
+		memset(&rm->processTable[i], 0, sizeof(PCB));
+		rm->processTable[i].pid = -1;
+	}
+
+	for (int i = 0; i < NUM_RESOURCES; i++) {
+		ResourceDesc *resource = &rm->resourceTable[i];
+		resource->totalInstances = INSTANCES_PER_RESOURCE;
+		resource->availableInstances = INSTANCES_PER_RESOURCE;
+		resource->head = 0;
+		resource->tail = 0;
+		resource->wakePolicy = WAKE_RING;
+		for (int j = 0; j < MAX_PCB; j++) {
+			resource->resourceAllocated[j] = 0;
+		}
+		for (int j = 0; j < QUEUE_SLOTS; j++) {
+			resource->requestQueue[j] = -1; // -1 means empty slot in queue
+		}
+	}
+}
+
+int resmgrSetPolicies(ResourceManager *rm, char *list) {
+	char copy[128];
+	strncpy(copy, list, sizeof(copy) - 1);
+	copy[sizeof(copy) - 1] = '\0';
+
+	int policy = -1;
+	int resourceID = 0;
+	char *name = strtok(copy, ",");
+	while (name && resourceID < NUM_RESOURCES) { // One name per resource in order
+		policy = -1;
+		for (int i = 0; i < NUM_WAKE_POLICIES; i++) {
+			if (strcmp(name, wakePolicyNames[i]) == 0) {
+				policy = i;
+			}
+		}
+		if (policy == -1) {
+			return -1;
+		}
+		rm->resourceTable[resourceID++].wakePolicy = policy;
+		name = strtok(NULL, ",");
+	}
+
+	if (name || policy == -1) { // More names than resources, or none at all
+		return -1;
+	}
+	while (resourceID < NUM_RESOURCES) { // Resources not listed use the last policy given
+		rm->resourceTable[resourceID++].wakePolicy = policy;
+	}
+	return 0;
+}
+
+void resmgrAccount(ResourceManager *rm, int elapsed) {
+	for (int i = 0; i < NUM_RESOURCES; i++) {
+		ResourceDesc *resource = &rm->resourceTable[i];
+		WaitStats *waitStats = &rm->waitStats[resource->wakePolicy];
+		waitStats->busyTime += (unsigned long long) (resource->totalInstances - resource->availableInstances) * elapsed;
+		waitStats->capacityTime += (unsigned long long) resource->totalInstances * elapsed;
+	}
+}
+
+int resmgrFindFree(ResourceManager *rm) {
+	for (int i = 0; i < MAX_PCB; i++) {
+		if (!rm->processTable[i].occupied) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int resmgrLookup(ResourceManager *rm, pid_t pid) {
+	for (int i = 0; i < MAX_PCB; i++) {
+		if (rm->processTable[i].occupied && rm->processTable[i].pid == pid) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void resmgrRegister(ResourceManager *rm, int pcbIndex, pid_t pid, int priority) {
+	PCB *pcb = &rm->processTable[pcbIndex];
+	memset(pcb, 0, sizeof(PCB));
+	pcb->occupied = 1;
+	pcb->pid = pid;
+	pcb->priority = priority;
+}
+
+static void enqueueWaiter(ResourceDesc *resource, int pcbIndex) {
+	resource->requestQueue[resource->tail] = pcbIndex;
+	resource->tail = (resource->tail + 1) % QUEUE_SLOTS;
+}
+
+static void compactQueue(ResourceDesc *resource) { // Close the holes left by out of order grants so the ring never laps live entries
+	int waiting[MAX_PCB];
+	int count = 0;
+	for (int slot = resource->head; slot != resource->tail; slot = (slot + 1) % QUEUE_SLOTS) {
+		if (resource->requestQueue[slot] != -1) {
+			waiting[count++] = resource->requestQueue[slot];
+		}
+	}
+
+	for (int i = 0; i < QUEUE_SLOTS; i++) {
+		resource->requestQueue[i] = (i < count) ? waiting[i] : -1;
+	}
+	resource->head = 0;
+	resource->tail = count;
+}
+
+static void removeWaiter(ResourceManager *rm, int pcbIndex) { // Drop a process from every wait queue
+	for (int i = 0; i < NUM_RESOURCES; i++) {
+		for (int slot = 0; slot < QUEUE_SLOTS; slot++) {
+			if (rm->resourceTable[i].requestQueue[slot] == pcbIndex) {
+				rm->resourceTable[i].requestQueue[slot] = -1;
+			}
+		}
+		compactQueue(&rm->resourceTable[i]);
+	}
+}
+
+static int selectRing(ResourceManager *rm, ResourceDesc *resource, unsigned long long now) {
+	for (int slot = resource->head; slot != resource->tail; slot = (slot + 1) % QUEUE_SLOTS) {
+		int pcbIndex = resource->requestQueue[slot];
+		if (pcbIndex != -1 && rm->processTable[pcbIndex].pendingQuantity <= resource->availableInstances) {
+			return slot;
+		}
+	}
+	return -1;
+}
+
+static int selectFifo(ResourceManager *rm, ResourceDesc *resource, unsigned long long now) {
+	for (int slot = resource->head; slot != resource->tail; slot = (slot + 1) % QUEUE_SLOTS) {
+		if (resource->requestQueue[slot] != -1) { // Only ever the oldest waiter
+			return slot;
+		}
+	}
+	return -1;
+}
+
+static int selectSmallest(ResourceManager *rm, ResourceDesc *resource, unsigned long long now) {
+	PCB *processTable = rm->processTable;
+	int best = -1;
+	for (int slot = resource->head; slot != resource->tail; slot = (slot + 1) % QUEUE_SLOTS) {
+		int pcbIndex = resource->requestQueue[slot];
+		if (pcbIndex == -1 || processTable[pcbIndex].pendingQuantity > resource->availableInstances) {
+			continue;
+		}
+		if (best == -1 || processTable[pcbIndex].pendingQuantity < processTable[resource->requestQueue[best]].pendingQuantity) {
+			best = slot;
+		}
+	}
+	return best;
+}
+
+static int selectAging(ResourceManager *rm, ResourceDesc *resource, unsigned long long now) {
+	PCB *processTable = rm->processTable;
+	int best = -1; // Highest priority waiter that fits
+	int bestPriority = -1;
+	for (int slot = resource->head; slot != resource->tail; slot = (slot + 1) % QUEUE_SLOTS) {
+		int pcbIndex = resource->requestQueue[slot];
+		if (pcbIndex == -1) {
+			continue;
+		}
+
+		int priority = processTable[pcbIndex].priority + (int) ((now - processTable[pcbIndex].blockedAt) / AGING_STEP);
+		if (processTable[pcbIndex].pendingQuantity <= resource->availableInstances && priority > bestPriority) {
+			best = slot;
+			bestPriority = priority;
+		}
+	}
+
+	return best;
+}
+
+// Waiter that freed units are held back for, or -1. A protected waiter (preempted PREEMPT_LIMIT times) comes first under every policy, then the
+// head under fifo, or under aging the longest waiter once it has waited AGING_RESERVE. Both waking and new requests respect it, otherwise
+// units freed for a big claimant go to whoever asks next. Waiters flagged in skip are ignored, detection uses that for ones it has let finish.
+static int reservedWaiter(ResourceManager *rm, ResourceDesc *resource, unsigned long long now, int *skip) {
+	for (int slot = resource->head; slot != resource->tail; slot = (slot + 1) % QUEUE_SLOTS) { // Queue order, so the oldest protected waiter
+		int pcbIndex = resource->requestQueue[slot];
+		if (pcbIndex != -1 && !(skip && skip[pcbIndex]) && rm->processTable[pcbIndex].preemptCount >= PREEMPT_LIMIT) {
+			return slot;
+		}
+	}
+
+	if (resource->wakePolicy != WAKE_FIFO && resource->wakePolicy != WAKE_AGING) {
+		return -1;
+	}
+
+	int oldest = -1;
+	for (int slot = resource->head; slot != resource->tail; slot = (slot + 1) % QUEUE_SLOTS) {
+		int pcbIndex = resource->requestQueue[slot];
+		if (pcbIndex == -1 || (skip && skip[pcbIndex])) {
+			continue;
+		}
+		if (resource->wakePolicy == WAKE_FIFO) { // Only ever the head
+			return slot;
+		}
+		if (oldest == -1 || rm->processTable[pcbIndex].blockedAt < rm->processTable[resource->requestQueue[oldest]].blockedAt) {
+			oldest = slot;
+		}
+	}
+	if (oldest != -1 && now - rm->processTable[resource->requestQueue[oldest]].blockedAt >= AGING_RESERVE) { // Waited too long, nobody else goes first
+		return oldest;
+	}
+	return -1;
+}
+
+static int reservedSlot(ResourceManager *rm, ResourceDesc *resource, unsigned long long now) {
+	return reservedWaiter(rm, resource, now, NULL);
+}
+
+static int reservedUnits(ResourceManager *rm, ResourceDesc *resource, int slot) { // What a newcomer or other waiter has to leave for the reserved one
+	if (slot == -1) {
+		return 0;
+	}
+	// Strict fifo never lets anyone past the head
+	return (resource->wakePolicy == WAKE_FIFO) ? resource->totalInstances : rm->processTable[resource->requestQueue[slot]].pendingQuantity;
+}
+
+static void recordWait(WaitStats *waitStats, unsigned long long wait) {
+	int bucket = 0;
+	while (bucket < WAIT_BUCKETS - 1 && wait >= waitBucketBounds[bucket]) {
+		bucket++;
+	}
+	waitStats->histogram[bucket]++;
+
+	waitStats->count++;
+	waitStats->totalWait += wait;
+	if (wait > waitStats->maxWait) {
+		waitStats->maxWait = wait;
+	}
+
+	unsigned int micro = (wait / 1000 > 0xffffffffULL) ? 0xffffffffU : (unsigned int) (wait / 1000);
+	if (waitStats->count <= WAIT_SAMPLES) {
+		waitStats->samples[waitStats->count - 1] = micro;
+	} else { // Reservoir sampling keeps an even sample of every wait
+		int slot = rand() % waitStats->count;
+		if (slot < WAIT_SAMPLES) {
+			waitStats->samples[slot] = micro;
+		}
+	}
+}
+
+static int wakeWaiters(ResourceManager *rm, int resourceID, unsigned long long now, ResmgrGrant *grants) { // Grant waiters per the resource's policy, returns how many
+	ResourceDesc *resource = &rm->resourceTable[resourceID];
+	WakeSelect select = wakeSelectors[resource->wakePolicy];
+	int numGranted = 0;
+
+	while (1) {
+		int slot = reservedSlot(rm, resource, now);
+		if (slot == -1) {
+			slot = select(rm, resource, now);
+		}
+		if (slot == -1) {
+			break;
+		}
+
+		int pcbIndex = resource->requestQueue[slot];
+		PCB *pcb = &rm->processTable[pcbIndex];
+		int quantity = pcb->pendingQuantity;
+		if (quantity > resource->availableInstances) { // Picked waiter doesn't fit yet, hold the units for it
+			break;
+		}
+
+		// Allocating resources to process
+		resource->availableInstances -= quantity;
+		resource->resourceAllocated[pcbIndex] += quantity;
+		pcb->resourceAllocated[resourceID] += quantity;
+		pcb->blocked = 0;
+		resource->requestQueue[slot] = -1; // Mark this queue slot as empty since request is granted
+
+		recordWait(&rm->waitStats[resource->wakePolicy], now - pcb->blockedAt);
+		grants[numGranted].pcbIndex = pcbIndex;
+		grants[numGranted].resourceID = resourceID;
+		grants[numGranted].quantity = quantity;
+		numGranted++;
+	}
+
+	compactQueue(resource);
+	return numGranted;
+}
+
+int resmgrRequest(ResourceManager *rm, int pcbIndex, int resourceID, int quantity, unsigned long long now) {
+	if (resourceID < 0 || resourceID >= NUM_RESOURCES || quantity <= 0 || quantity > rm->resourceTable[resourceID].totalInstances) {
+		return RESMGR_INVALID;
+	}
+	if (rm->processTable[pcbIndex].blocked) { // Already queued somewhere, a second entry would overrun a ring sized for one per process
+		return RESMGR_INVALID;
+	}
+
+	ResourceDesc *resource = &rm->resourceTable[resourceID];
+	PCB *pcb = &rm->processTable[pcbIndex];
+	int slot = reservedSlot(rm, resource, now);
+	if (pcb->preemptCount >= PREEMPT_LIMIT && slot != -1 && rm->processTable[resource->requestQueue[slot]].preemptCount < PREEMPT_LIMIT) {
+		slot = -1; // Protected newcomer goes ahead of every unprotected waiter, as it would once queued
+	}
+	int reserved = reservedUnits(rm, resource, slot); // Units held back for a waiter, a newcomer can only have what's left over
+
+	if (resource->availableInstances - reserved >= quantity) { // Granting resource request meaning reducing how much is available once granted.
+		resource->availableInstances -= quantity;
+		resource->resourceAllocated[pcbIndex] += quantity;
+		pcb->resourceAllocated[resourceID] += quantity;
+		return RESMGR_GRANTED;
+	}
+
+	// Add process to wait queue and block it until resources are allocated.
+	enqueueWaiter(resource, pcbIndex);
+	pcb->blocked = 1;
+	pcb->pendingResource = resourceID;
+	pcb->pendingQuantity = quantity;
+	pcb->blockedAt = now;
+	return RESMGR_BLOCKED;
+}
+
+static void freeHeld(ResourceManager *rm, int pcbIndex, int resourceID) { // Return what a process holds of one resource to the pool
+	rm->resourceTable[resourceID].availableInstances += rm->processTable[pcbIndex].resourceAllocated[resourceID];
+	rm->resourceTable[resourceID].resourceAllocated[pcbIndex] = 0;
+	rm->processTable[pcbIndex].resourceAllocated[resourceID] = 0;
+}
+
+int resmgrRelease(ResourceManager *rm, int pcbIndex, int resourceID, unsigned long long now, ResmgrGrant *grants) {
+	if (resourceID < 0 || resourceID >= NUM_RESOURCES) {
+		return 0;
+	}
+	freeHeld(rm, pcbIndex, resourceID);
+	return wakeWaiters(rm, resourceID, now, grants); // Even with nothing freed, aging priorities move with time
+}
+
+static int reclaim(ResourceManager *rm, int pcbIndex, unsigned long long now, ResmgrGrant *grants) { // Take back everything a process holds or waits for
+	removeWaiter(rm, pcbIndex);
+	rm->processTable[pcbIndex].blocked = 0;
+
+	for (int j = 0; j < NUM_RESOURCES; j++) {
+		freeHeld(rm, pcbIndex, j);
+	}
+	if (!grants) {
+		return 0;
+	}
+
+	int numGranted = 0;
+	for (int j = 0; j < NUM_RESOURCES; j++) { // Freed units may unblock others, each waiter is blocked on one resource so MAX_PCB is enough
+		numGranted += wakeWaiters(rm, j, now, grants + numGranted);
+	}
+	return numGranted;
+}
+
+int resmgrUnregister(ResourceManager *rm, int pcbIndex, unsigned long long now, ResmgrGrant *grants) {
+	int numGranted = reclaim(rm, pcbIndex, now, grants);
+	rm->processTable[pcbIndex].occupied = 0;
+	rm->processTable[pcbIndex].pid = -1;
+	rm->processTable[pcbIndex].adopted = 0;
+	return numGranted;
+}
+
+// Detection on pending requests: processes that aren't blocked are assumed to finish and hand back what they hold, then any blocked process whose
+// pending request fits in what is free plus what finished processes returned can finish too, minus whatever is held back for the waiter its resource
+// reserves units for. Whoever is left can never be woken.
+int resmgrDetect(ResourceManager *rm, int *deadlocked, unsigned long long now) {
+	int work[NUM_RESOURCES];
+	int finished[MAX_PCB];
+	for (int j = 0; j < NUM_RESOURCES; j++) {
+		work[j] = rm->resourceTable[j].availableInstances;
+	}
+	for (int i = 0; i < MAX_PCB; i++) { // Running processes can always finish
+		PCB *pcb = &rm->processTable[i];
+		finished[i] = !pcb->occupied || !pcb->blocked;
+		for (int j = 0; pcb->occupied && !pcb->blocked && j < NUM_RESOURCES; j++) {
+			work[j] += pcb->resourceAllocated[j];
+		}
+	}
+
+	int progress = 1;
+	while (progress) { // Keep finishing blocked processes whose request fits until nothing changes
+		progress = 0;
+		for (int i = 0; i < MAX_PCB; i++) {
+			PCB *pcb = &rm->processTable[i];
+			if (finished[i]) {
+				continue;
+			}
+			ResourceDesc *resource = &rm->resourceTable[pcb->pendingResource];
+			int slot = reservedWaiter(rm, resource, now, finished);
+			int reserved = (slot != -1 && resource->requestQueue[slot] != i) ? reservedUnits(rm, resource, slot) : 0;
+			if (pcb->pendingQuantity > work[pcb->pendingResource] - reserved) {
+				continue;
+			}
+			finished[i] = 1;
+			progress = 1;
+			for (int j = 0; j < NUM_RESOURCES; j++) {
+				work[j] += pcb->resourceAllocated[j];
+			}
+		}
+	}
+
+	int count = 0;
+	for (int i = 0; i < MAX_PCB; i++) { // If resource cannot be allocated, mark it as deadlocked.
+		if (!finished[i]) {
+			deadlocked[count++] = i;
+		}
+	}
+	return count;
+}
+
+static int victimCost(ResourceManager *rm, int pcbIndex) { // Preemption count dominates so victims rotate and protected ones go last, then units lost
+	int held = 0;
+	for (int j = 0; j < NUM_RESOURCES; j++) {
+		held += rm->processTable[pcbIndex].resourceAllocated[j];
+	}
+	return rm->processTable[pcbIndex].preemptCount * (NUM_RESOURCES * INSTANCES_PER_RESOURCE + 1) + held;
+}
+
+int resmgrPreemptVictim(ResourceManager *rm, int *deadlocked, int count) {
+	int victim = -1;
+	for (int i = 0; i < count; i++) {
+		int pcbIndex = deadlocked[i];
+		if (rm->processTable[pcbIndex].preemptCount < PREEMPT_LIMIT && (victim == -1 || victimCost(rm, pcbIndex) < victimCost(rm, victim))) {
+			victim = pcbIndex;
+		}
+	}
+	return victim;
+}
+
+int resmgrKillVictim(ResourceManager *rm, int *deadlocked, int count) {
+	int victim = deadlocked[0];
+	for (int i = 1; i < count; i++) {
+		if (victimCost(rm, deadlocked[i]) < victimCost(rm, victim)) {
+			victim = deadlocked[i];
+		}
+	}
+	return victim;
+}
+
+int resmgrPreempt(ResourceManager *rm, int pcbIndex, unsigned long long now, ResmgrGrant *grants) {
+	int numGranted = reclaim(rm, pcbIndex, now, grants); // Its pending request is dropped, the worker requests again after rolling back
+	rm->processTable[pcbIndex].preemptCount++;
+	rm->processTable[pcbIndex].priority = NUM_PRIORITIES; // Above every base priority, so aging serves it first next time it waits
+	return numGranted;
+}
+
+static int compareSamples(const void *a, const void *b) {
+	unsigned int x = *(const unsigned int *) a;
+	unsigned int y = *(const unsigned int *) b;
+	return (x > y) - (x < y);
+}
+
+void resmgrPrintWaitStats(ResourceManager *rm, FILE *out) {
+	for (int i = 0; i < NUM_WAKE_POLICIES; i++) {
+		WaitStats *waitStats = &rm->waitStats[i];
+		if (waitStats->capacityTime == 0) { // Policy not used by any resource
+			continue;
+		}
+
+		double utilization = (double) waitStats->busyTime / waitStats->capacityTime * 100;
+		fprintf(out, "Wake-up Policy %s: %d woken, utilization %.2f%%\n", wakePolicyNames[i], waitStats->count, utilization);
+		if (waitStats->count == 0) {
+			continue;
+		}
+
+		int numSamples = (waitStats->count < WAIT_SAMPLES) ? waitStats->count : WAIT_SAMPLES;
+		unsigned int sorted[WAIT_SAMPLES];
+		memcpy(sorted, waitStats->samples, sizeof(unsigned int) * numSamples);
+		qsort(sorted, numSamples, sizeof(unsigned int), compareSamples);
+
+		fprintf(out, "  Wait (ms): mean %.2f p50 %.2f p90 %.2f p99 %.2f max %.2f\n", (double) waitStats->totalWait / waitStats->count / 1000000,
+				sorted[numSamples * 50 / 100] / 1000.0, sorted[numSamples * 90 / 100] / 1000.0, sorted[numSamples * 99 / 100] / 1000.0, (double) waitStats->maxWait / 1000000);
+		fprintf(out, "  Wait histogram: <10ms %d, <50ms %d, <100ms %d, <500ms %d, <1s %d, >=1s %d\n", waitStats->histogram[0], waitStats->histogram[1],
+				waitStats->histogram[2], waitStats->histogram[3], waitStats->histogram[4], waitStats->histogram[5]);
+	}
+}
@@ -0,0 +1,53 @@
+#ifndef RESMGR_H
+#define RESMGR_H
+
+#include <stdio.h>
+#include "oss.h"
+
+#define RESMGR_GRANTED 0 // Request fit and was allocated
+#define RESMGR_BLOCKED 1 // Request queued on the resource, the process is blocked until a release or reclaim wakes it
+#define RESMGR_INVALID -1 // Bad resource or quantity, or the process is already blocked, nothing changed
+
+// resmgr.h is the resource manager oss runs the simulation with: granting, releasing, wait queues with their wake-up policies, deadlock
+// detection and taking resources back from a victim. It only works on the tables it is given and never touches IPC, clocks or processes,
+// so the same code runs inside oss and in bench_resmgr. Times are simulated nanoseconds passed in by the caller.
+
+typedef struct ResourceManager { // Tables the manager works on, owned by the caller
+	PCB *processTable; // MAX_PCB entries
+	ResourceDesc *resourceTable; // NUM_RESOURCES entries, in oss these live in the shared region
+	WaitStats *waitStats; // NUM_WAKE_POLICIES entries, wait times and utilization per policy
+} ResourceManager;
+
+typedef struct ResmgrGrant { // A blocked request that went through, the caller tells the worker
+	int pcbIndex;
+	int resourceID;
+	int quantity;
+} ResmgrGrant;
+
+extern char *wakePolicyNames[NUM_WAKE_POLICIES];
+
+void resmgrInit(ResourceManager *rm, PCB *processTable, ResourceDesc *resourceTable, WaitStats *waitStats); // Bind the tables, contents are left alone
+void resmgrReset(ResourceManager *rm); // Empty process table, every resource free with empty queues under the ring policy
+int resmgrSetPolicies(ResourceManager *rm, char *list); // Set each resource's wake-up policy from a comma separated list, -1 if invalid
+void resmgrAccount(ResourceManager *rm, int elapsed); // Add elapsed ns of utilization for every resource
+
+int resmgrFindFree(ResourceManager *rm); // Free PCB slot, -1 if the table is full
+int resmgrLookup(ResourceManager *rm, pid_t pid); // PCB slot of an active process, -1 if unknown
+void resmgrRegister(ResourceManager *rm, int pcbIndex, pid_t pid, int priority); // Take a free slot, holding nothing
+
+// Requests and releases. Grants to waiters woken by freed units go into grants (room for MAX_PCB), the return value is how many.
+// Unregister frees whatever the process still holds, grants may be NULL there to free the units without waking anyone.
+int resmgrRequest(ResourceManager *rm, int pcbIndex, int resourceID, int quantity, unsigned long long now); // RESMGR_GRANTED, RESMGR_BLOCKED or RESMGR_INVALID
+int resmgrRelease(ResourceManager *rm, int pcbIndex, int resourceID, unsigned long long now, ResmgrGrant *grants); // Give back everything held of resourceID
+int resmgrUnregister(ResourceManager *rm, int pcbIndex, unsigned long long now, ResmgrGrant *grants); // Process is gone or killed, frees its slot
+
+// Deadlock handling. Detect lists blocked processes whose pending requests can never be met, even once every other process that can finish has, in table order.
+// Units a resource holds back for a reserved waiter count as unavailable to the others, so now is needed for the aging reservation.
+int resmgrDetect(ResourceManager *rm, int *deadlocked, unsigned long long now);
+int resmgrPreemptVictim(ResourceManager *rm, int *deadlocked, int count); // Least preempted, then least held, skipping protected ones, -1 if none
+int resmgrKillVictim(ResourceManager *rm, int *deadlocked, int count); // Same cost with nobody skipped, so protected processes are killed last
+int resmgrPreempt(ResourceManager *rm, int pcbIndex, unsigned long long now, ResmgrGrant *grants); // Take everything back, the process stays registered
+
+void resmgrPrintWaitStats(ResourceManager *rm, FILE *out);
+
+#endif
@@ -2,46 +2,28 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/msg.h>
-#include <sys/shm.h>
 #include <sys/ipc.h>
 #include <signal.h>
 #include <time.h>
 #include "oss.h"
+#include "workload.h"
+#include "region.h"
 
-#define NANO_TO_SEC 1000000000
-#define BOUND 500000000 // 0.5 second bound to request/release
-#define REQUEST_PROBABILITY 80 // 80% chance to request, 30% to release
-#define TERMINATION_PROBABILITY 1
+#define NANO_TO_SEC 1000000000ULL
 
 // Author: Dat Nguyen
 // user.c is an exe called upon by oss.c during forking, it will either request resources or release them, each process of this is stored in a process table in oss.c. Then, at random, they will terminate.
+// How it requests, releases and terminates is set by a workload profile (see workload.h), passed as ./user [profile] [seed]. Without arguments it runs the "default" profile seeded by its pid.
 
 int main(int argc, char* argv[]) {
 	
-	// Attach to simulated clock
-    	int shmid = shmget(SHM_KEY, sizeof(SimulatedClock), 0666);
-    	SimulatedClock *clock = (SimulatedClock *)shmat(shmid, NULL, 0);
-	if (shmid == -1) { // If shmid is -1 as a result of shmget failing and returning -1, error message will print.
-		printf("Error: User shmget failed. \n");
-        	exit(1);
-	}
-	if (clock == (void *)-1) { // if shmat, the attaching shared memory function, fails, it returns an invalid memory address.
-		printf("Error: User shared memory attachment failed. \n");
-		exit(1);
-	}
-
-    	// Attach to resource table
-    	int shmResourceID = shmget(RESOURCE_KEY, sizeof(ResourceDesc) * NUM_RESOURCES, 0666);
-    	if (shmResourceID == -1) { // Error message in case creating shm fails.
-    		printf("OSS Error: Failed to allocate shared memory for resource table");
-    		exit(1);
-	}
-	
-	ResourceDesc *resourceTable = (ResourceDesc *)shmat(shmResourceID, NULL, 0);
-	if (resourceTable == (void *) -1) { // Error message in case of attatch fail.
-    		printf("Error: OSS Failed to attach shared memory for resource table");
+	// Attach to shared region holding the simulated clock and resource table
+	RegionMapping mapping;
+	if (regionAttach(&mapping) == -1) {
+		printf("Error: User failed to attach shared memory region. \n");
 		exit(1);
 	}
+	SimulatedClock *clock = &mapping.region->clock;
 
     	// Message queue
     	int msgid = msgget(MSG_KEY, 0666);
@@ -50,24 +32,50 @@ int main(int argc, char* argv[]) {
                 exit(1);
         }
 
+	// Workload profile
+	WorkloadProfile profile;
+	const char *profileName = (argc > 1) ? argv[1] : "default";
+	if (loadProfile(profileName, &profile) == -1) {
+		printf("Error: User failed to load workload profile %s. \n", profileName);
+		exit(1);
+	}
+
     	// Local resource tracking
     	int resourceHeld[NUM_RESOURCES] = {0};
+	unsigned long long holdUntil[NUM_RESOURCES] = {0}; // Earliest time each held resource may be released
+
+	if (argc > 2) { // Seed given by oss for repeatable runs
+		srand((unsigned int) strtoul(argv[2], NULL, 10)); // oss prints it with %u
+	} else {
+		srand(getpid()); // Randomizer for each child
+	}
 
-	srand(getpid()); // Randomizer for each child
 	// Start time for resource allocation
-    	unsigned int lastCheck = clock->seconds * NANO_TO_SEC + clock->nanoseconds;
-    	unsigned int startTime = lastCheck;
+    	unsigned long long startTime = (unsigned long long) clock->seconds * NANO_TO_SEC + clock->nanoseconds;
+	int phaseIndex = 0;
+	const WorkloadPhase *phase = &profile.phases[phaseIndex];
+	unsigned long long phaseStart = startTime;
+	unsigned long long nextAction = startTime + sampleInterArrival(phase);
 	
        	while (1) { // Main loop
-	       	unsigned int currentTime = clock->seconds * NANO_TO_SEC + clock->nanoseconds;
-		if ((currentTime - startTime) >= NANO_TO_SEC) { // Run at least 1 second
+	       	unsigned long long currentTime = (unsigned long long) clock->seconds * NANO_TO_SEC + clock->nanoseconds;
+
+		if (phase->duration > 0 && (currentTime - phaseStart) >= phase->duration) { // Move on to the next phase
+			phaseIndex = (phaseIndex + 1) % profile.numPhases;
+			phase = &profile.phases[phaseIndex];
+			phaseStart = currentTime;
+			nextAction = currentTime + sampleInterArrival(phase);
+		}
+
+		if ((currentTime - startTime) >= profile.minRuntime) { // Run at least the profile's minimum runtime
 	    		int terminateCheck = rand() % 100; // Roll for termination
-	    		if (terminateCheck < TERMINATION_PROBABILITY) { // 10% chance to terminate
+	    		if (terminateCheck < phase->terminationProbability) {
 				for (int i = 0; i < NUM_RESOURCES; i++) {
 		    			if (resourceHeld[i] > 0) { // Send message to OSS indicating termination
 						OssMSG releaseMsg;
 						releaseMsg.mtype = 1;
 						releaseMsg.pid = getpid();
+						releaseMsg.type = MSG_RELEASE;
 						releaseMsg.resourceID = i;
 						releaseMsg.quantity = -1; // negative indicates release
 						msgsnd(msgid, &releaseMsg, sizeof(OssMSG) - sizeof(long), 0);
@@ -77,33 +85,48 @@ int main(int argc, char* argv[]) {
 	    		}
 		}
 		
-		if ((currentTime - lastCheck) >= BOUND) { // Request / Release
-	    		lastCheck = currentTime;
+		if (currentTime >= nextAction) { // Request / Release
+	    		nextAction = currentTime + sampleInterArrival(phase);
 	    		
 			// Update action to determine if we request OR release
 			int action = rand() % 100;
-	    		int resourceID = rand() % NUM_RESOURCES;
+	    		int resourceID = sampleResource(phase);
 	    
-			if (action < REQUEST_PROBABILITY) {  // Request
+			if (action < phase->requestProbability) {  // Request
 				if (resourceHeld[resourceID] == 0) { // Send message to oss requesting resources
 		    			OssMSG request;
 		    			request.mtype = 1;
 		    			request.pid = getpid();
+		    			request.type = MSG_REQUEST;
 		    			request.resourceID = resourceID;
-		    			request.quantity = 1;
-		    			msgsnd(msgid, &request, sizeof(OssMSG) - sizeof(long), 0);
+		    			request.quantity = sampleQuantity(phase);
 		    
 					OssMSG response; // Get response from OSS.
-		    			msgrcv(msgid, &response, sizeof(OssMSG) - sizeof(long), getpid(), 0);
+					do {
+		    				msgsnd(msgid, &request, sizeof(OssMSG) - sizeof(long), 0);
+		    				if (msgrcv(msgid, &response, sizeof(OssMSG) - sizeof(long), getpid(), 0) == -1) { // Queue removed, oss is gone
+							regionDetach(&mapping);
+							exit(1);
+						}
+						if (response.type == MSG_PREEMPT) { // oss took everything back to break a deadlock, roll back and ask again
+							for (int i = 0; i < NUM_RESOURCES; i++) {
+								resourceHeld[i] = 0;
+								holdUntil[i] = 0;
+							}
+						}
+					} while (response.type == MSG_PREEMPT);
+
 		    			if (response.quantity > 0) { // IF successful, update resources held
 						resourceHeld[resourceID] += response.quantity;
+						holdUntil[resourceID] = (unsigned long long) clock->seconds * NANO_TO_SEC + clock->nanoseconds + sampleHold(phase);
 		    			}
 				}
 	    		} else { // Release
-				if (resourceHeld[resourceID] > 0) { // Send message to OSS releasing resources
+				if (resourceHeld[resourceID] > 0 && currentTime >= holdUntil[resourceID]) { // Send message to OSS releasing resources once held long enough
 		    			OssMSG release;
 		    			release.mtype = 1;
 		    			release.pid = getpid();
+		    			release.type = MSG_RELEASE;
 		    			release.resourceID = resourceID;
 		    			release.quantity = -1; // negative indicates release
 		    			msgsnd(msgid, &release, sizeof(OssMSG) - sizeof(long), 0);
@@ -114,8 +137,7 @@ int main(int argc, char* argv[]) {
 	}
 
 	// Detach resources
-	shmdt(clock);
-	shmdt(resourceTable);
+	regionDetach(&mapping);
 
 	return 0;
 }
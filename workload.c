@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "workload.h"
+
+#define MS_TO_NANO 1000000ULL
+
+// workload.c holds the built in workload profiles, the profile file loader and the random samplers user.c uses to drive its requests.
+// A profile file is plain text with one 'key value' pair per line, '#' starts a comment and 'phase' starts a new phase, for example:
+//	name mine
+//	minRuntime 1000000000
+//	phase
+//	zipfSkew 1.2
+//	maxQuantity 3
+// Keys that are not given keep the values of the default profile.
+
+static const WorkloadProfile builtinProfiles[] = {
+	// Original user.c behaviour: uniform resources, 1 unit, an action every 0.5 seconds, 1% exit chance after 1 second.
+	{ "default", 1000 * MS_TO_NANO, 1, {
+		{ 0, 0.0, 1, 1, ARRIVAL_FIXED, 500 * MS_TO_NANO, 0, 80, 1 } } },
+	// A few hot resources take most of the traffic.
+	{ "hotspot", 1000 * MS_TO_NANO, 1, {
+		{ 0, 1.2, 1, 2, ARRIVAL_EXPONENTIAL, 250 * MS_TO_NANO, 0, 80, 1 } } },
+	// Short bursts of rapid requests followed by quiet stretches.
+	{ "bursty", 1000 * MS_TO_NANO, 2, {
+		{ 300 * MS_TO_NANO, 0.5, 1, 2, ARRIVAL_EXPONENTIAL, 20 * MS_TO_NANO, 0, 90, 0 },
+		{ 1200 * MS_TO_NANO, 0.0, 1, 1, ARRIVAL_EXPONENTIAL, 600 * MS_TO_NANO, 0, 50, 1 } } },
+	// Workers that hang on to what they get and live longer.
+	{ "longhold", 3000 * MS_TO_NANO, 1, {
+		{ 0, 0.0, 1, 2, ARRIVAL_FIXED, 500 * MS_TO_NANO, 2000 * MS_TO_NANO, 80, 1 } } },
+	// Many-unit requests.
+	{ "bulk", 1000 * MS_TO_NANO, 1, {
+		{ 0, 0.0, 3, 8, ARRIVAL_EXPONENTIAL, 500 * MS_TO_NANO, 500 * MS_TO_NANO, 70, 1 } } },
+	// Light uniform start that shifts into heavy hot spot traffic.
+	{ "shift", 1000 * MS_TO_NANO, 2, {
+		{ 1000 * MS_TO_NANO, 0.0, 1, 1, ARRIVAL_FIXED, 500 * MS_TO_NANO, 0, 80, 1 },
+		{ 2000 * MS_TO_NANO, 1.5, 2, 4, ARRIVAL_EXPONENTIAL, 200 * MS_TO_NANO, 300 * MS_TO_NANO, 85, 1 } } },
+};
+
+#define NUM_BUILTIN_PROFILES (int)(sizeof(builtinProfiles) / sizeof(builtinProfiles[0]))
+
+static int validateProfile(const WorkloadProfile *profile) { // Make sure a loaded profile makes sense before using it.
+	if (profile->numPhases < 1 || profile->numPhases > MAX_PHASES) {
+		return -1;
+	}
+
+	for (int i = 0; i < profile->numPhases; i++) {
+		const WorkloadPhase *phase = &profile->phases[i];
+		if (phase->zipfSkew < 0 || phase->minQuantity < 1 || phase->maxQuantity < phase->minQuantity) {
+			return -1;
+		}
+		if (phase->maxQuantity > INSTANCES_PER_RESOURCE) { // Can never be granted
+			return -1;
+		}
+		if (phase->arrivalDist != ARRIVAL_FIXED && phase->arrivalDist != ARRIVAL_EXPONENTIAL) {
+			return -1;
+		}
+		if (phase->meanInterArrival == 0) {
+			return -1;
+		}
+		if (phase->requestProbability < 0 || phase->requestProbability > 100 || phase->terminationProbability < 0 || phase->terminationProbability > 100) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int loadProfileFile(const char *path, WorkloadProfile *profile) { // Parse a profile file on top of the default profile.
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		return -1;
+	}
+
+	*profile = builtinProfiles[0];
+	strncpy(profile->name, path, MAX_PROFILE_NAME - 1);
+	profile->name[MAX_PROFILE_NAME - 1] = '\0';
+	profile->numPhases = 0;
+
+	char line[256];
+	int phase = -1; // Current phase being filled in
+	int error = 0;
+	while (!error && fgets(line, sizeof(line), file)) {
+		char *comment = strchr(line, '#');
+		if (comment) {
+			*comment = '\0';
+		}
+
+		char key[64];
+		char value[64];
+		int fields = sscanf(line, "%63s %63s", key, value);
+		if (fields <= 0) { // Blank line
+			continue;
+		}
+
+		if (strcmp(key, "phase") == 0) { // Start a new phase, seeded from the default one
+			if (profile->numPhases == MAX_PHASES) {
+				error = 1;
+				break;
+			}
+			phase = profile->numPhases++;
+			profile->phases[phase] = builtinProfiles[0].phases[0];
+			continue;
+		}
+
+		if (fields != 2) {
+			error = 1;
+			break;
+		}
+
+		if (strcmp(key, "name") == 0) {
+			strncpy(profile->name, value, MAX_PROFILE_NAME - 1);
+			continue;
+		}
+		if (strcmp(key, "minRuntime") == 0) {
+			profile->minRuntime = strtoull(value, NULL, 10);
+			continue;
+		}
+
+		if (phase == -1) { // Phase keys before any 'phase' line go into the first phase
+			phase = profile->numPhases++;
+			profile->phases[phase] = builtinProfiles[0].phases[0];
+		}
+
+		WorkloadPhase *current = &profile->phases[phase];
+		if (strcmp(key, "duration") == 0) {
+			current->duration = strtoull(value, NULL, 10);
+		} else if (strcmp(key, "zipfSkew") == 0) {
+			current->zipfSkew = atof(value);
+		} else if (strcmp(key, "minQuantity") == 0) {
+			current->minQuantity = atoi(value);
+		} else if (strcmp(key, "maxQuantity") == 0) {
+			current->maxQuantity = atoi(value);
+		} else if (strcmp(key, "arrival") == 0) {
+			if (strcmp(value, "fixed") == 0) {
+				current->arrivalDist = ARRIVAL_FIXED;
+			} else if (strcmp(value, "exponential") == 0) {
+				current->arrivalDist = ARRIVAL_EXPONENTIAL;
+			} else {
+				error = 1;
+			}
+		} else if (strcmp(key, "meanInterArrival") == 0) {
+			current->meanInterArrival = strtoull(value, NULL, 10);
+		} else if (strcmp(key, "meanHold") == 0) {
+			current->meanHold = strtoull(value, NULL, 10);
+		} else if (strcmp(key, "requestProbability") == 0) {
+			current->requestProbability = atoi(value);
+		} else if (strcmp(key, "terminationProbability") == 0) {
+			current->terminationProbability = atoi(value);
+		} else { // Unknown key
+			error = 1;
+		}
+	}
+	fclose(file);
+
+	if (error || validateProfile(profile) == -1) {
+		return -1;
+	}
+	return 0;
+}
+
+int loadProfile(const char *nameOrPath, WorkloadProfile *profile) {
+	for (int i = 0; i < NUM_BUILTIN_PROFILES; i++) { // Built in names win over files
+		if (strcmp(builtinProfiles[i].name, nameOrPath) == 0) {
+			*profile = builtinProfiles[i];
+			return 0;
+		}
+	}
+	return loadProfileFile(nameOrPath, profile);
+}
+
+void listProfiles(FILE *out) {
+	for (int i = 0; i < NUM_BUILTIN_PROFILES; i++) {
+		fprintf(out, "%s%s", i ? ", " : "", builtinProfiles[i].name);
+	}
+}
+
+static double uniformRandom() { // Random number in (0, 1)
+	return (rand() + 1.0) / ((double) RAND_MAX + 2.0);
+}
+
+static unsigned long long exponentialRandom(unsigned long long mean) {
+	return (unsigned long long) (-log(uniformRandom()) * mean);
+}
+
+int sampleResource(const WorkloadPhase *phase) {
+	if (phase->zipfSkew == 0.0) { // Uniform, same as the original rand() % NUM_RESOURCES
+		return rand() % NUM_RESOURCES;
+	}
+
+	// Zipf: resource k gets weight 1 / (k + 1)^skew
+	double weights[NUM_RESOURCES];
+	double total = 0.0;
+	for (int i = 0; i < NUM_RESOURCES; i++) {
+		weights[i] = 1.0 / pow(i + 1, phase->zipfSkew);
+		total += weights[i];
+	}
+
+	double pick = uniformRandom() * total;
+	for (int i = 0; i < NUM_RESOURCES; i++) {
+		pick -= weights[i];
+		if (pick <= 0.0) {
+			return i;
+		}
+	}
+	return NUM_RESOURCES - 1;
+}
+
+int sampleQuantity(const WorkloadPhase *phase) {
+	return phase->minQuantity + rand() % (phase->maxQuantity - phase->minQuantity + 1);
+}
+
+unsigned long long sampleInterArrival(const WorkloadPhase *phase) {
+	if (phase->arrivalDist == ARRIVAL_EXPONENTIAL) {
+		return exponentialRandom(phase->meanInterArrival);
+	}
+	return phase->meanInterArrival;
+}
+
+unsigned long long sampleHold(const WorkloadPhase *phase) {
+	if (phase->meanHold == 0) {
+		return 0;
+	}
+	return exponentialRandom(phase->meanHold);
+}
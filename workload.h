@@ -0,0 +1,43 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stdio.h>
+#include "oss.h"
+
+#define MAX_PHASES 4
+#define MAX_PROFILE_NAME 32
+#define ARRIVAL_FIXED 0 // Every action waits exactly meanInterArrival
+#define ARRIVAL_EXPONENTIAL 1 // Poisson arrivals with mean meanInterArrival
+
+// workload.h describes the workload profiles user.c runs under. A profile is a list of phases, each phase sets how a worker picks resources,
+// how many units it asks for, how often it acts, how long it holds what it gets and when it may terminate. Phases cycle once their duration is up.
+
+typedef struct WorkloadPhase { // One stage of a profile, times are simulated nanoseconds
+	unsigned long long duration; // How long this phase lasts before moving to the next one, 0 means forever
+	double zipfSkew; // Skew over resources, 0 is uniform, larger values make R0 hotter
+	int minQuantity; // Smallest amount of units per request
+	int maxQuantity; // Largest amount of units per request
+	int arrivalDist; // ARRIVAL_FIXED or ARRIVAL_EXPONENTIAL
+	unsigned long long meanInterArrival; // Mean time between request/release actions
+	unsigned long long meanHold; // Mean time a resource is held before it may be released, 0 means release any time
+	int requestProbability; // % chance an action is a request instead of a release
+	int terminationProbability; // % chance per check to terminate once minRuntime has passed
+} WorkloadPhase;
+
+typedef struct WorkloadProfile { // Named profile, either built in or loaded from a file
+	char name[MAX_PROFILE_NAME];
+	unsigned long long minRuntime; // Worker runs at least this long before it may terminate
+	int numPhases;
+	WorkloadPhase phases[MAX_PHASES];
+} WorkloadProfile;
+
+int loadProfile(const char *nameOrPath, WorkloadProfile *profile); // Look up built in profile by name, else parse it from a file. Returns 0 on success, -1 on failure.
+void listProfiles(FILE *out); // Print the names of the built in profiles
+
+// Sampling helpers, all use rand() so srand() makes runs repeatable.
+int sampleResource(const WorkloadPhase *phase); // Pick a resource with the phase's Zipf skew
+int sampleQuantity(const WorkloadPhase *phase); // Pick a request size between min and max quantity
+unsigned long long sampleInterArrival(const WorkloadPhase *phase); // Time until the next action
+unsigned long long sampleHold(const WorkloadPhase *phase); // How long a grant is held
+
+#endif